@@ -0,0 +1,322 @@
+/* Benchmark for every qs_manager adapter: for each operation it reports the time (ns/op), the bytes
+    allocated and the number of copies of T per call.
+
+    Usage: qs_manager_benchmark [max size (trivial T)] [max size (heavy T)]
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include <map>
+#include <stdexcept>
+#include <iostream>
+#if defined(_MSC_VER)
+    #include <intrin.h> // _ReadWriteBarrier
+#endif
+
+
+// Count bytes allocated (not inlined: GCC would pair the inlined 'free' with the builtin 'operator new')
+#if defined(_MSC_VER)
+    #define BENCHMARK_NOINLINE __declspec(noinline)
+#else
+    #define BENCHMARK_NOINLINE __attribute__((noinline))
+#endif
+
+namespace {
+    std::atomic<std::size_t> allocated_bytes(0);
+    }
+
+BENCHMARK_NOINLINE void* operator new(std::size_t size) {
+    allocated_bytes += size;
+    void* ptr = std::malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+        }
+    return ptr;
+    }
+
+BENCHMARK_NOINLINE void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+    }
+
+BENCHMARK_NOINLINE void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+    }
+
+
+// Objects stored in the containers: they count their copies
+template <class Payload>
+struct item {
+    item() : id(0) {};
+    explicit item(int id) : id(id), payload(id) {};
+    item(const item& other) : id(other.id), payload(other.payload) { ++copies; };
+    item(item&& other) : id(other.id), payload(std::move(other.payload)) {};
+    item& operator=(const item& other) {
+        id = other.id;
+        payload = other.payload;
+        ++copies;
+        return *this;
+        };
+    item& operator=(item&& other) {
+        id = other.id;
+        payload = std::move(other.payload);
+        return *this;
+        };
+
+    int id;
+    Payload payload;
+    static std::atomic<std::size_t> copies;
+    };
+
+template <class Payload>
+std::atomic<std::size_t> item<Payload>::copies(0);
+
+struct trivial_payload {
+    trivial_payload() {};
+    explicit trivial_payload(int) {};
+    };
+
+struct heavy_payload {
+    heavy_payload() {};
+    explicit heavy_payload(int id) : name("object with a name long enough to be on the heap #" + std::to_string(id)), values(16, double(id)) {};
+    std::string name;
+    std::vector<double> values;
+    };
+
+typedef item<trivial_payload> trivial;
+typedef item<heavy_payload> heavy;
+
+
+// Lookups by id: compare native keys
+namespace core {
+    namespace utils {
+        namespace qs_manager_implementation {
+            template <class Payload>
+            int key_of(const item<Payload>& obj) {
+                return obj.id;
+                }
+
+            bool to_key(const std::string& id, int& key) {
+                char* end = nullptr;
+                long value = std::strtol(id.c_str(), &end, 10);
+                if (id.empty() || *end != '\0') {
+                    return false;
+                    }
+                key = int(value);
+                return true;
+                }
+            }}}
+
+#include "core/utils/qs_manager.h"
+
+
+// Sources for each adapter
+template <class T>
+struct A {
+    const std::vector<T>& all() const { return _all; };
+    std::vector<T> _all;
+    };
+
+template <class T>
+struct B {
+    void all(std::vector<T>& all) const { all = _all; };
+    std::vector<T> _all;
+    };
+
+template <class T>
+struct AMap {
+    const std::map<std::string, T>& all() const { return _all; };
+    std::map<std::string, T> _all;
+    };
+
+template <class T>
+struct BMap {
+    void all(std::map<std::string, T>& all) const { all = _all; };
+    std::map<std::string, T> _all;
+    };
+
+// Vectors get a duplicated id ('n') so 'get' can raise multiple_objects_found, maps cannot have it.
+template <class T>
+void fill(std::vector<T>& data, std::size_t n) {
+    data.reserve(n + 2);
+    for (std::size_t i = 0; i < n; ++i) {
+        data.push_back(T(int(i)));
+        }
+    data.push_back(T(int(n)));
+    data.push_back(T(int(n)));
+    }
+
+template <class T>
+void fill(std::map<std::string, T>& data, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        data.insert(std::make_pair(std::to_string(i), T(int(i))));
+        }
+    }
+
+template <class T> std::vector<T>& data_of(std::vector<T>& source) { return source; }
+template <class T> std::map<std::string, T>& data_of(std::map<std::string, T>& source) { return source; }
+template <class Source> auto data_of(Source& source) -> decltype(source._all)& { return source._all; }
+
+
+// Measure an operation: results are added to 'sink' and 'do_not_optimize' makes the compiler believe it is read
+//  after every call (and that any memory may have changed), so the calls are neither discarded nor hoisted.
+namespace {
+    std::size_t sink = 0;
+    const double min_time_ns = 5e7;
+    const std::size_t max_iterations = 1 << 20;
+
+#if defined(_MSC_VER)
+    const void* volatile escape = nullptr;
+
+    template <class T>
+    inline void do_not_optimize(const T& value) {
+        escape = &value;
+        _ReadWriteBarrier();
+        }
+#else
+    template <class T>
+    inline void do_not_optimize(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+        }
+#endif
+    }
+
+struct result {
+    double ns;
+    double bytes;
+    double copies;
+    };
+
+template <class T, class Op>
+result measure(Op op) {
+    op(); // warm up: snapshots, indexes,...
+    std::size_t iterations = 1;
+    for (;;) {
+        std::size_t bytes = allocated_bytes, copies = T::copies;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < iterations; ++i) {
+            op();
+            do_not_optimize(sink);
+            }
+        double elapsed = double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        if (elapsed >= min_time_ns || iterations >= max_iterations) {
+            result ret = { elapsed/iterations, double(allocated_bytes - bytes)/iterations, double(T::copies - copies)/iterations };
+            return ret;
+            }
+        iterations *= 2;
+        }
+    }
+
+void report(const char* adapter, const char* type, std::size_t n, const char* operation, const result& res) {
+    std::printf("%-8s %-8s %10zu  %-18s %16.1f %16.1f %14.1f\n", adapter, type, n, operation, res.ns, res.bytes, res.copies);
+    std::fflush(stdout);
+    }
+
+template <class T, class Manager>
+void run_operations(const char* adapter, const char* type, std::size_t n, const Manager& manager, bool duplicates) {
+    const std::string hit = std::to_string(n/2), miss = "-1", dup = std::to_string(n);
+    report(adapter, type, n, "all()", measure<T>([&manager]() { sink += manager.all().size(); }));
+    report(adapter, type, n, "count()", measure<T>([&manager]() { sink += manager.count(); }));
+    report(adapter, type, n, "get() hit", measure<T>([&manager, &hit]() { sink += manager.get(hit).id; }));
+    report(adapter, type, n, "get() miss", measure<T>([&manager, &miss]() {
+        try {
+            sink += manager.get(miss).id;
+            }
+        catch (core::utils::object_not_found&) {
+            ++sink;
+            }
+        }));
+    if (duplicates) {
+        report(adapter, type, n, "get() duplicate", measure<T>([&manager, &dup]() {
+            try {
+                sink += manager.get(dup).id;
+                }
+            catch (core::utils::multiple_objects_found&) {
+                ++sink;
+                }
+            }));
+        }
+    }
+
+template <class T, class Source>
+void run(const char* adapter, const char* type, std::size_t n, bool vector) {
+    Source source;
+    fill(data_of(source), n);
+    core::utils::qs_manager<T, Source, std::string> manager(source);
+    run_operations<T>(adapter, type, n, manager, vector);
+    }
+
+template <class T, class Source>
+void run_indexed(const char* adapter, const char* type, std::size_t n) {
+    Source source;
+    fill(data_of(source), n);
+    core::utils::qs_manager<T, Source, std::string> manager(source);
+    manager.use_index();
+    const std::string hit = std::to_string(n/2);
+    report(adapter, type, n, "get() hit, index", measure<T>([&manager, &hit]() { sink += manager.get(hit).id; }));
+    }
+
+template <class T, class Source>
+void run_column(const char* adapter, const char* type, std::size_t n) {
+    Source source;
+    fill(data_of(source), n);
+    core::utils::qs_manager<T, Source, std::string> manager(source);
+    manager.use_column();
+    const std::string hit = std::to_string(n/2);
+    report(adapter, type, n, "get() hit, column", measure<T>([&manager, &hit]() { sink += manager.get(hit).id; }));
+    }
+
+template <class T, class Source>
+void run_cached(const char* adapter, const char* type, std::size_t n) {
+    Source source;
+    fill(data_of(source), n);
+    core::utils::qs_manager<T, Source, std::string> manager(source);
+    manager.use_cache(1024);
+    const std::string hit = std::to_string(n/2);
+    report(adapter, type, n, "get() hit, cache", measure<T>([&manager, &hit]() { sink += manager.get(hit).id; }));
+    }
+
+template <class T>
+void run_frozen(const char* type, std::size_t n) {
+    std::vector<T> source;
+    fill(source, n);
+    core::utils::qs_manager<T, std::vector<T>, std::string> manager(source);
+    core::utils::qs_sorted_vector<int, T> frozen = manager.freeze();
+    core::utils::qs_manager<T, core::utils::qs_sorted_vector<int, T>, std::string> manager_frozen(frozen);
+    run_operations<T>("sorted", type, n, manager_frozen, true);
+    }
+
+template <class T>
+void run_all(const char* type, std::size_t max_size) {
+    for (std::size_t n = 10; n <= max_size; n *= 10) {
+        run<T, A<T> >("A", type, n, true);
+        run_indexed<T, A<T> >("A", type, n);
+        run_column<T, A<T> >("A", type, n);
+        run<T, B<T> >("B", type, n, true);
+        run_indexed<T, B<T> >("B", type, n);
+        run_column<T, B<T> >("B", type, n);
+        run_cached<T, B<T> >("B", type, n);
+        run<T, std::vector<T> >("vector", type, n, true);
+        run_indexed<T, std::vector<T> >("vector", type, n);
+        run_column<T, std::vector<T> >("vector", type, n);
+        run<T, AMap<T> >("AMap", type, n, false);
+        run<T, BMap<T> >("BMap", type, n, false);
+        run_cached<T, BMap<T> >("BMap", type, n);
+        run<T, std::map<std::string, T> >("map", type, n, false);
+        run_frozen<T>(type, n);
+        }
+    }
+
+int main(int argc, char* argv[]) {
+    std::size_t max_trivial = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+    std::size_t max_heavy = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+
+    std::printf("%-8s %-8s %10s  %-18s %16s %16s %14s\n", "adapter", "T", "size", "operation", "ns/op", "bytes/op", "copies/op");
+    run_all<trivial>("trivial", max_trivial);
+    run_all<heavy>("heavy", max_heavy);
+    return 0;
+    }
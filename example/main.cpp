@@ -1,139 +1,230 @@
-
-#include "stdafx.h"
-#include <iostream>
-#include <sstream>
-#include <string>
-
-#include "core/utils/qs_manager.h"
-
-
-class A {
-    public:
-        A() {};        
-        const std::vector<int>& all() const {
-            //std::cout << "call A::all vector" << std::endl;
-            return _all;
-            };
-    //protected:
-        std::vector<int> _all;
-    };
-
-class AMap {
-    public:
-        AMap() {};
-        const std::map<std::string, int>& all() const {
-            return _all;
-            };
-        std::map<std::string, int> _all;
-    };
-
-class B {
-    public:
-        B() {};
-        void all(std::vector<int>& all) const {
-            //std::cout << "call B::all vector" << std::endl;
-            all = _all;
-            };
-    //protected:
-        std::vector<int> _all;
-    };
-
-class BMap {
-    public:
-        BMap() {};
-        void all(std::map<std::string, int>& all) const {
-            //std::cout << "call B::all vector" << std::endl;
-            all = _all;
-            };
-        std::map<std::string, int> _all;
-    };
-
-
-// We need a compare operator for int - std::string
-template<typename T>
-struct convert {
-    struct exception : public std::runtime_error {
-        exception() : std::runtime_error("Conversion failed") {};
-        };
-
-    inline T operator()(const std::string& str) {
-        std::istringstream iss(str);
-        T obj;
-        iss >> std::ws >> obj >> std::ws;
-
-        if (!iss.eof()) throw exception();
-        return obj;
-        };
-    };
-
-namespace citef {
-    namespace core {
-        namespace qs_manager_implementation {
-            // Need to 'get' by id
-            bool operator==(const int& lhs, const std::string& rhs) {
-                try {
-                    return (lhs == convert<int>()(rhs));
-                    }
-                catch(convert<int>::exception&) {
-                    return false;
-                    }
-                }
-            }}}
-
-int main() {
-    std::cout << ">>> TEST #1: vector <<<" << std::endl;
-    std::cout << "Container with 'const std::vector<int>& all() const'" << std::endl;
-    A a;
-    citef::core::qs_manager<int, A, std::string> manager_A(a);
-    a._all.push_back(0);
-    a._all.push_back(1);
-    std::cout << "size: " << manager_A.all().size() << std::endl;
-    std::cout << "get('1'): " << manager_A.get("1") << std::endl;
-    std::cout << std::endl;
-
-    std::cout << "Container with 'void all(std::vector<int>&) const'" << std::endl;
-    B b;
-    citef::core::qs_manager<int, B, std::string> manager_B(b);
-    b._all.push_back(0);
-    b._all.push_back(1);
-    std::cout << "size: " << manager_B.all().size() << std::endl;
-    std::cout << "get('1'): " << manager_B.get("1") << std::endl;
-    std::cout << std::endl;
-
-    std::cout << "Container IS a 'std::vector<int>'" << std::endl;
-    std::vector<int> c;
-    citef::core::qs_manager<int, std::vector<int>, std::string> manager_C(c);
-    c.push_back(0);
-    c.push_back(1);
-    std::cout << "size: " << manager_C.all().size() << std::endl;
-    std::cout << "get('1'): " << manager_C.get("1") << std::endl;
-    std::cout << std::endl << std::endl;
-
-    std::cout << ">>> TEST #2: map <<<" << std::endl;
-    std::cout << "Container with 'const std::map<std::string, int>& all() const'" << std::endl;
-    AMap amap;
-    citef::core::qs_manager<int, AMap, std::string> manager_AMap(amap);
-    amap._all["0"] = 111;
-    std::cout << "size: " << manager_AMap.all().size() << std::endl;
-    std::cout << "get('0'): " << manager_AMap.get("0") << std::endl;
-    std::cout << std::endl;
-
-    std::cout << "Container with 'void all(std::map<std::string, int>&) const'" << std::endl;
-    BMap bmap;
-    citef::core::qs_manager<int, BMap, std::string> manager_BMap(bmap);
-    bmap._all["0"] = 222;
-    std::cout << "size: " << manager_BMap.all().size() << std::endl;
-    std::cout << "get('0'): " << manager_BMap.get("0") << std::endl;
-    std::cout << std::endl;
-
-    std::cout << "Container IS a 'std::map<std::string, int>'" << std::endl;
-    std::map<std::string, int> cmap;
-    citef::core::qs_manager<int, std::map<std::string, int>, std::string> manager_CMap(cmap);
-    cmap["0"] = 333;    
-    std::cout << "size: " << manager_CMap.all().size() << std::endl;
-    std::cout << "get('0'): " << manager_CMap.get("0") << std::endl;
-    std::cout << std::endl;
-
-    getchar();
-    return 0;
+
+#include "stdafx.h"
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+// We need a compare operator for int - std::string
+template<typename T>
+struct convert {
+    struct exception : public std::runtime_error {
+        exception() : std::runtime_error("Conversion failed") {};
+        };
+
+    inline T operator()(const std::string& str) {
+        std::istringstream iss(str);
+        T obj;
+        iss >> std::ws >> obj >> std::ws;
+
+        if (!iss.eof()) throw exception();
+        return obj;
+        };
+    };
+
+namespace core {
+    namespace utils {
+        namespace qs_manager_implementation {
+            // Need to 'get' by id (declared before including qs_manager.h, like every function in this namespace)
+            bool operator==(const int& lhs, const std::string& rhs) {
+                try {
+                    return (lhs == convert<int>()(rhs));
+                    }
+                catch(convert<int>::exception&) {
+                    return false;
+                    }
+                }
+
+            // Compare native keys: the id is converted just once per query (needed to 'use_index' too)
+            int key_of(const int& item) {
+                return item;
+                }
+
+            bool to_key(const std::string& id, int& key) {
+                try {
+                    key = convert<int>()(id);
+                    return true;
+                    }
+                catch(convert<int>::exception&) {
+                    return false;
+                    }
+                }
+            }}}
+
+#include "core/utils/qs_manager.h"
+#include "core/utils/qs_mmap.h"
+
+
+class A {
+    public:
+        A() {};        
+        const std::vector<int>& all() const {
+            //std::cout << "call A::all vector" << std::endl;
+            return _all;
+            };
+    //protected:
+        std::vector<int> _all;
+    };
+
+class AMap {
+    public:
+        AMap() {};
+        const std::map<std::string, int>& all() const {
+            return _all;
+            };
+        std::map<std::string, int> _all;
+    };
+
+class B {
+    public:
+        B() {};
+        void all(std::vector<int>& all) const {
+            //std::cout << "call B::all vector" << std::endl;
+            all = _all;
+            };
+    //protected:
+        std::vector<int> _all;
+    };
+
+class BMap {
+    public:
+        BMap() {};
+        void all(std::map<std::string, int>& all) const {
+            //std::cout << "call B::all vector" << std::endl;
+            all = _all;
+            };
+        std::map<std::string, int> _all;
+    };
+
+
+int main() {
+    std::cout << ">>> TEST #1: vector <<<" << std::endl;
+    std::cout << "Container with 'const std::vector<int>& all() const'" << std::endl;
+    A a;
+    core::utils::qs_manager<int, A, std::string> manager_A(a);
+    a._all.push_back(0);
+    a._all.push_back(1);
+    std::cout << "size: " << manager_A.all().size() << std::endl;
+    std::cout << "get('1'): " << manager_A.get("1") << std::endl;
+    manager_A.use_index(); // 'A' has no generation: call 'manager_A.reindex()' after changing objects in place
+    std::cout << "get('1') using index: " << manager_A.get("1") << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Container with 'void all(std::vector<int>&) const'" << std::endl;
+    B b;
+    core::utils::qs_manager<int, B, std::string> manager_B(b);
+    b._all.push_back(0);
+    b._all.push_back(1);
+    std::cout << "size: " << manager_B.all().size() << std::endl;
+    std::cout << "get('1'): " << manager_B.get("1") << std::endl;
+    manager_B.use_column();
+    std::cout << "get('1') using key column: " << manager_B.get("1") << std::endl;
+    std::vector<int> values_B(manager_B.begin(), manager_B.end()); // Both walk the copy taken by the last query
+    std::cout << "values (begin/end):";
+    for (int value : values_B) {
+        std::cout << " " << value;
+        }
+    std::cout << std::endl;
+    manager_B.use_cache(16); // 'B' has no generation: call 'manager_B.invalidate()' after changing it
+    std::cout << "get('1') using a cache (the container is not read again): " << manager_B.get("1") << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Container IS a 'std::vector<int>'" << std::endl;
+    std::vector<int> c;
+    core::utils::qs_manager<int, std::vector<int>, std::string> manager_C(c);
+    c.push_back(0);
+    c.push_back(1);
+    std::cout << "size: " << manager_C.all().size() << std::endl;
+    std::cout << "get('1'): " << manager_C.get("1") << std::endl;
+    std::cout << "filter(> 0): " << manager_C.filter([](const int& item) { return item > 0; }).size() << std::endl;
+    auto odd = manager_C.index_by([](const int& item) { return item % 2 != 0; }); // used if the container has a generation or notifies its changes
+    std::cout << "filter(odd): " << manager_C.filter(odd.eq(true)).size() << std::endl;
+    std::cout << "chunks(1):";
+    for (auto& batch : manager_C.chunks(1)) {
+        std::cout << " " << batch.size();
+        }
+    std::cout << std::endl;
+    std::cout << "sum: " << manager_C.sum([](const int& item) { return item; }) << ", count_if(odd): " << manager_C.count_if([](const int& item) { return item % 2 != 0; }) << std::endl;
+    std::cout << "top_k(1, descending): " << manager_C.top_k(1, [](const int& item) { return item; }, true).front() << std::endl;
+    std::cout << "query: first > 0: " << *manager_C.query().filter([](const int& item) { return item > 0; }).first().object << std::endl;
+    {
+        core::utils::qs_monotonic_resource arena;
+        core::utils::qs_manager<int, std::vector<int>, std::string> request_C(c, &arena);
+        request_C.use_index();
+        std::cout << "get('1') with index in an arena: " << request_C.get("1") << std::endl;
+        }
+    std::cout << std::endl << std::endl;
+
+    std::cout << ">>> TEST #2: map <<<" << std::endl;
+    std::cout << "Container with 'const std::map<std::string, int>& all() const'" << std::endl;
+    AMap amap;
+    core::utils::qs_manager<int, AMap, std::string> manager_AMap(amap);
+    amap._all["0"] = 111;
+    std::cout << "size: " << manager_AMap.all().size() << std::endl;
+    std::cout << "get('0'): " << manager_AMap.get("0") << std::endl;
+    std::cout << "try_get('1') found: " << bool(manager_AMap.try_get("1")) << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Container with 'void all(std::map<std::string, int>&) const'" << std::endl;
+    BMap bmap;
+    core::utils::qs_manager<int, BMap, std::string> manager_BMap(bmap);
+    bmap._all["0"] = 222;
+    std::cout << "size: " << manager_BMap.all().size() << std::endl;
+    std::cout << "get('0'): " << manager_BMap.get("0") << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Container IS a 'std::map<std::string, int>'" << std::endl;
+    std::map<std::string, int> cmap;
+    core::utils::qs_manager<int, std::map<std::string, int>, std::string> manager_CMap(cmap);
+    cmap["0"] = 333;    
+    std::cout << "size: " << manager_CMap.all().size() << std::endl;
+    std::cout << "get('0'): " << manager_CMap.get("0") << std::endl;
+    std::cout << "all_refs (no copies): " << *manager_CMap.all_refs().front() << std::endl;
+    std::cout << "values:";
+    for (auto it = manager_CMap.begin(); it != manager_CMap.end(); ++it) {
+        std::cout << " " << *it;
+        }
+    std::cout << std::endl << std::endl;
+
+    std::cout << "Frozen copy of 'manager_CMap' (sorted vector)" << std::endl;
+    core::utils::qs_sorted_vector<std::string, int> frozen_CMap = manager_CMap.freeze();
+    core::utils::qs_manager<int, core::utils::qs_sorted_vector<std::string, int>, std::string> manager_frozen(frozen_CMap);
+    std::cout << "get('0'): " << manager_frozen.get("0") << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "File mapped in memory with the data of 'manager_C'" << std::endl;
+    core::utils::qs_mmap_map<int, int>::write("qs_manager_example.qs", manager_C.freeze());
+    {
+        core::utils::qs_mmap_map<int, int> mapped_C("qs_manager_example.qs");
+        core::utils::qs_manager<int, core::utils::qs_mmap_map<int, int>, std::string> manager_mapped(mapped_C);
+        std::cout << "size: " << manager_mapped.count() << std::endl;
+        std::cout << "get('1'): " << manager_mapped.get("1") << std::endl;
+        }
+    std::remove("qs_manager_example.qs");
+    std::cout << std::endl;
+
+    std::cout << "Snapshot of 'manager_BMap' (it can be shared among threads)" << std::endl;
+    auto snapshot_BMap = manager_BMap.snapshot();
+    std::cout << "size: " << snapshot_BMap.count() << std::endl;
+    std::cout << "get('0'): " << snapshot_BMap.get("0") << std::endl;
+    std::cout << std::endl;
+
+    std::cout << ">>> TEST #3: federated <<<" << std::endl;
+    std::cout << "Shards 'a' (vector), 'b' (vector copy) and 'cmap' (map)" << std::endl;
+    core::utils::qs_federated_manager<int, std::string> federated;
+    federated.add(a).use_index();
+    federated.add(b);
+    federated.add(cmap);
+    std::cout << "count: " << federated.count() << std::endl;
+    std::cout << "get('0') status: " << int(federated.try_get("0").status) << " (in 'a', 'b' and 'cmap')" << std::endl;
+    std::cout << "filter(> 100): " << federated.filter([](const int& item) { return item > 100; }).size() << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Stats for 'manager_BMap' (compile with QS_MANAGER_STATS to collect them)" << std::endl;
+    manager_BMap.stats().dump(std::cout);
+    std::cout << std::endl;
+
+    getchar();
+    return 0;
     }
\ No newline at end of file
@@ -1,440 +1,4502 @@
-#pragma once
-
-#include <exception>
-#include <vector>
-#include <map>
-#include <iterator>
-#include <algorithm>
-#include "has_member.hpp"
-
-/* Implements (or tries to) an unified way of working with containers of several types: maps, vectors, multimaps,...
-    in a way all of them could inherit from the same interface and be treated the same way.
-*/
-
-namespace core {
-    namespace utils {
-
-        /* Define exceptions for this class
-            * object_not_found: no object found
-            * multiple_objects_found: multiple objects found
-        */
-        class object_not_found : public std::runtime_error {
-            public:
-                object_not_found(const std::string& id) : std::runtime_error(std::string("No object found for id '") + id +"'") {};
-            };
-
-        class multiple_objects_found : public std::runtime_error {
-            public:
-                multiple_objects_found(const std::string& id) : std::runtime_error(std::string("Multiple objects found for id '") + id + "'") {};
-            };
-
-        template <class T, class TContainer, class ID> class qs_manager; // forward declaration
-
-        namespace _private {
-            /* Some private for easier template implementation on qs_manager.
-            */
-            template <typename All_Container>
-            struct check_all_to_container {
-                template <typename T, void (T::*)(typename All_Container&) const = &T::all>
-                struct get {};
-                };
-
-            template <typename T, typename ContainerType>
-            struct has_all_to_container : has_member<T, typename check_all_to_container<ContainerType>> {};
-            
-            template <typename All_Container>
-            struct check_all_as_container {
-                template <typename T, const typename All_Container& (T::*)() const = &T::all>
-                struct get {};
-                };
-
-            template <typename T, typename ContainerType>
-            struct has_all_as_container : has_member<T, typename check_all_as_container<ContainerType>> {};
-            
-            // To implement
-            template <class T, class ID, class ClassToTest, typename Enable = void>
-            class qs_manager_get_impl {
-                public:
-                    qs_manager_get_impl<T, ID, ClassToTest, Enable>(const typename ClassToTest& container) {
-                        static_assert( false, "<ClassToTest> is not implemented as a valid container for 'qs_manager'");
-                        };
-
-                    void all(std::vector<T>& ret) const {
-                        static_assert( false, "<ClassToTest> is not implemented as a valid container for 'qs_manager'");
-                        };
-
-                    const std::vector<T>& all() const {
-                        static_assert( false, "<ClassToTest> is not implemented as a valid container for 'qs_manager'");
-                        };
-
-                    const size_t count() const {
-                        static_assert( false, "<ClassToTest> is not implemented as a valid container for 'qs_manager'");
-                        };
-
-                    const T& get(const ID& id) const {
-                        static_assert( false, "<ClassToTest> is not implemented as a valid container for 'qs_manager'");
-                        };
-                };
-           
-/**********************
-    VECTORS
-***********************/
-            // Vector implementations
-            template <class T, class ID, typename Enable = void>
-            class qs_manager_getter_vector {
-                public:
-                    virtual const std::vector<T>& all() const = 0;
-                    const T& get(const ID& id) const {
-                        static_assert(false, "To use 'get' on qs_manager with a vector implementation you must define 'bool ::core::qs_manager_implementation::operator==(const T&, const ID&)' function ");
-                        }
-                };
-            
-            
-            // SFINAE comparison operator for 'bool operator==(const T&, const ID&)'
-            struct dummy {};
-            void operator==(const dummy&, const dummy&);
-
-            // bool operator==(const int&, const std::string&); // This is detected. namespaces!
-
-            template <typename T, typename ID>
-            struct is_operator_available {
-                template <typename T1, typename ID1>
-                static decltype(::core::utils::qs_manager_implementation::operator==(T1(), ID1())) test(int, int);
-                template <typename, typename>
-                static void test(...);
-
-                enum { value = !std::is_void<decltype(test<T, ID>(0, 0))>::value};
-                };
-            
-            
-            template <class T, class ID>
-            class qs_manager_getter_vector<T, ID,
-                typename std::enable_if< is_operator_available<T, ID>::value >::type
-                > {
-                public:
-                    virtual const std::vector<T>& all() const = 0;
-                    virtual const size_t count() const {
-                        return this->all().size();
-                        };
-                    const T& get(const ID& id) const {
-                        // We have to iterate all elements to look for one (check if there are many)
-                        const std::vector<T>& all = this->all();
-                        std::vector<T>::const_iterator found = all.end(), begin = all.begin(), end = all.end();
-                        while (begin != end) {
-                            if ( ::core::utils::qs_manager_implementation::operator==(*begin,id)) {
-                                if (found != all.end()) {
-                                    throw multiple_objects_found(id);
-                                    }
-                                found = begin;
-                                }
-                            ++begin;
-                            }
-                        if (found == all.end()) {
-                            throw object_not_found(id);
-                            }
-                        return *found;
-                        };
-                };
-            
-
-            // - all to vector
-            template <class T, class ID, class ClassToTest>
-            class qs_manager_get_impl<T, ID, ClassToTest,
-                    typename std::enable_if<has_all_to_container<ClassToTest, std::vector<T> >::value>::type
-                    > : public qs_manager_getter_vector<T, ID>
-                {
-                public:
-                    qs_manager_get_impl<T, ID, ClassToTest,
-                    typename std::enable_if<has_all_to_container<ClassToTest, std::vector<T> >::value>::type
-                    >(const typename ClassToTest& container) : _container(container) {                        
-                        };
-
-                    void all(std::vector<T>& ret) const {
-                        _container.all(ret);
-                        };
-
-                    const std::vector<T>& all() const {
-                        _container.all(__all); // We have to update this vector each time because it may have been updated.
-                        return __all;
-                        };
-
-                    //const T& __get(const ID& id) const {};
-                protected:
-                    const typename ClassToTest& _container;
-                private:
-                    mutable std::vector<T> __all;
-                };
-
-            // - all returns vector.
-            template <class T, class ID, class ClassToTest>
-            class qs_manager_get_impl<T, ID, ClassToTest,
-                    typename std::enable_if<has_all_as_container<ClassToTest, std::vector<T> >::value>::type
-                    > : public qs_manager_getter_vector<T, ID>
-                {
-                public:
-                    qs_manager_get_impl<T, ID, ClassToTest,
-                     typename std::enable_if<has_all_as_container<ClassToTest, std::vector<T> >::value>::type
-                    >(const typename ClassToTest& container) : _container(container) {                        
-                        };
-
-                    void all(std::vector<T>& ret) const {
-                        ret = _container.all();
-                        };
-
-                    const std::vector<T>& all() const {
-                        return _container.all();
-                        };
-
-                protected:
-                    const typename ClassToTest& _container;
-                };
-
-            // - container IS a vector
-            template <class T, class ID>
-            class qs_manager_get_impl<T, ID, typename std::vector<T>, void> : public qs_manager_getter_vector<T, ID> {
-                public:
-                    qs_manager_get_impl<T, ID, typename std::vector<T>, void>(const typename std::vector<T>& container) : _container(container) {
-                        };
-
-                    void all(std::vector<T>& ret) const {
-                        ret = _container;
-                        };
-
-                    const std::vector<T>& all() const {
-                        return _container;
-                        };
-
-                protected:
-                    const typename std::vector<T>& _container;
-                };
-
-/**********************
-    MAPS
-***********************/
-            // Map implementations
-            template <class T, class ID>
-            class qs_manager_getter_map {
-                public:
-                    virtual const size_t count() const = 0;
-
-                    const T& get(const ID& id) const {
-                        // There cannot be duplicates on maps
-                        const std::map<ID, T>& all = this->__get_all();
-                        std::map<ID, T>::const_iterator it = all.find(id);
-                        if (it == all.end()) {
-                            throw object_not_found(id);
-                            }
-                        return it->second;
-                        };
-                protected:
-                    virtual const std::map<ID, T>& __get_all() const = 0;
-                };
-
-            // Credit: http://stackoverflow.com/questions/771453/copy-map-values-to-vector-in-stl
-            template <typename tPair>
-            struct second_t {
-                typename tPair::second_type operator()(const tPair& p) const { return p.second;};
-                };
-            template <typename tMap>
-            second_t<typename tMap::value_type> second(const tMap& m) { return second_t<typename tMap::value_type>();};
-                    
-            // - all to map
-            template <class T, class ID, class ClassToTest>
-            class qs_manager_get_impl<T, ID, ClassToTest,
-                    typename std::enable_if<has_all_to_container<ClassToTest, std::map<ID, T> >::value>::type
-                    > : public qs_manager_getter_map<T, ID>
-                {
-                public:
-                    qs_manager_get_impl<T, ID, ClassToTest,
-                    typename std::enable_if<has_all_to_container<ClassToTest, std::map<ID, T> >::value>::type
-                    >(const typename ClassToTest& container) : _container(container) {                        
-                        };
-
-                    virtual const size_t count() const {
-                        std::map<ID, T> map;
-                        _container.all(map);
-                        return map.size();
-                        };
-
-                    void all(std::vector<T>& ret) const {
-                        std::map<ID, T> map;
-                        _container.all(map);
-                        std::transform( map.begin(), map.end(), std::back_inserter(ret), second(map));
-                        };
-
-                    const std::vector<T>& all() const {
-                        std::map<ID, T> map;
-                        _container.all(map); // We have to update this vector each time because it may have been updated.
-                        __all.clear();
-                        std::transform( map.begin(), map.end(), std::back_inserter(__all), second(map));
-                        return __all;
-                        };
-
-                private:
-                    const std::map<ID, T>& __get_all() const {
-                        _container.all(__all_map);
-                        return __all_map;
-                        };
-
-                protected:
-                    const typename ClassToTest& _container;
-                private:
-                    mutable std::vector<T> __all;
-                    mutable std::map<ID, T> __all_map;
-                };
-
-            // - all returns map.
-            template <class T, class ID, class ClassToTest>
-            class qs_manager_get_impl<T, ID, ClassToTest,
-                    typename std::enable_if<has_all_as_container<ClassToTest, std::map<ID, T> >::value>::type
-                    > : public qs_manager_getter_map<T, ID>
-                {
-                public:
-                    qs_manager_get_impl<T, ID, ClassToTest,
-                     typename std::enable_if<has_all_as_container<ClassToTest, std::map<ID, T> >::value>::type
-                    >(const typename ClassToTest& container) : _container(container) {                        
-                        };
-
-                    virtual const size_t count() const {
-                        return _container.all().size();
-                        };
-
-                    void all(std::vector<T>& ret) const {
-                        const std::map<ID, T>& all = _container.all();
-                        std::transform( all.begin(), all.end(), std::back_inserter(ret), second(all));
-                        };
-
-                    const std::vector<T>& all() const {
-                        const std::map<ID, T>& all = _container.all();
-                        __all.clear();
-                        std::transform( all.begin(), all.end(), std::back_inserter(__all), second(all));
-                        return __all;
-                        };
-
-                private:
-                    const std::map<ID, T>& __get_all() const {
-                        return _container.all();
-                        };
-
-                protected:
-                    const typename ClassToTest& _container;
-                private:
-                    mutable std::vector<T> __all;
-                };
-
-            // - container IS a map
-            template <class T, class ID>
-            class qs_manager_get_impl<T, ID, typename std::map<ID, T>, void> : public qs_manager_getter_map<T, ID> {
-                public:
-                    qs_manager_get_impl<T, ID, typename std::map<ID, T>, void>(const typename std::map<ID, T>& container) : _container(container) {
-                        };
-
-                    virtual const size_t count() const {
-                        return _container.size();
-                        };
-
-                    void all(std::vector<T>& ret) const {
-                        std::transform( _container.begin(), _container.end(), std::back_inserter(ret), second(_container));
-                        };
-
-                    const std::vector<T>& all() const {
-                        __all.clear();
-                        std::transform( _container.begin(), _container.end(), std::back_inserter(__all), second(_container));
-                        return __all;
-                        };
-
-                private:
-                    const std::map<ID, T>& __get_all() const {
-                        return _container;
-                        };
-
-                protected:
-                    const typename std::map<ID, T>& _container;
-                private:
-                    mutable std::vector<T> __all;
-                };
-
-/**********************
-    MULTIMAPS
-***********************/
-
-            }
-
-
-/**********************
-    JUST THE CLASS
-***********************/
-
-        template <class T, class TContainer, class ID=std::string>
-        class qs_manager : public _private::qs_manager_get_impl<T, ID, TContainer> {
-            public:
-                //typedef typename core::smart_ptr<T>::shared _t_type_ptr; // Just for reference, use signal_ptr, connection_ptr,... instead
-                typedef T _t_type_ptr;
-                typedef std::vector<_t_type_ptr> _t_type_ptr_vector;
-
-            public:
-                qs_manager(const typename TContainer& container) : _private::qs_manager_get_impl<T, ID, TContainer>(container), _container(container) {};
-                /*
-                // Methods to retrieve ALL data
-                virtual const _t_type_ptr_vector& all() const throw() {
-                    #ifdef LOG_ERROR
-                        LOG_ERROR("Not implemented");
-                        static _t_type_ptr_vector __empty_vector;
-                        return __empty_vector;
-                    #else
-                        throw std::runtime_exception("Not implemneted");
-                    #endif
-                    };
-                */
-                //
-                virtual void test() const throw() {
-                    std::cout << "void qs_manager::test()" << std::endl;
-                    //this->get("");
-                    //vector = this->all();
-                    };
-                
-                /*
-                // Methods to filter data
-                virtual _t_type_ptr_vector filter(std::function<bool (const _t_type_ptr& ptr)> filter_func) const {
-                    _t_type_ptr_vector results;
-                    this->filter(filter_func, results);
-                    return results;
-                    };
-
-                virtual int filter(std::function<bool (const _t_type_ptr& ptr)> filter_func, _t_type_ptr_vector& results) const {
-                    int prev = results.size();
-                    const _t_type_ptr_vector& allqs = this->all();
-                    std::for_each(allqs.begin(), allqs.end(), [&results, &filter_func](const _t_type_ptr_vector::value_type& item) {
-                        if (filter_func(item.second)) {
-                            results.insert(item);
-                            }
-                        });
-                    return (results.size()-prev);
-                    };
-
-                // Methods to get data
-                virtual int get(const ID& id, _t_type_ptr& ptr) const throw() {
-                    try {
-                        ptr = this->get(id);
-                        return 0;
-                        }
-                    catch (object_not_found&) {
-                        return -1;
-                        }
-                    catch (multiple_objects_found& e) {
-                        return -2;
-                        }
-                    };
-
-                virtual const _t_type_ptr& get(const ID& id) const {
-                    return _private::get<T, TContainer, ID>(id, *this);
-                    };
-                */
-            protected:
-                const typename TContainer& _container;
-            };
-
-        }
-    }
-
-                
+#pragma once
+
+#include <exception>
+#include <vector>
+#include <map>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <system_error>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <ostream>
+#include <iostream>
+#include <sstream>
+#include <typeinfo>
+#include <cstddef>
+#ifdef QS_MANAGER_STATS_LATENCY
+    #include <chrono>
+#endif
+#if defined(__has_include)
+    #if __has_include(<memory_resource>) && (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+        #include <memory_resource>
+        #define QS_MANAGER_HAS_PMR
+    #endif
+#endif
+#include "has_member.hpp"
+
+// Minimum number of items each thread works on when qs_manager runs something in parallel
+#ifndef QS_MANAGER_PARALLEL_MIN_CHUNK
+    #define QS_MANAGER_PARALLEL_MIN_CHUNK 16384
+#endif
+
+// SIMD instructions to scan key columns (see 'use_column'), define QS_MANAGER_NO_SIMD to use plain loops
+#ifndef QS_MANAGER_NO_SIMD
+    #if defined(__AVX2__)
+        #define QS_MANAGER_SIMD_AVX2
+        #include <immintrin.h>
+    #elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define QS_MANAGER_SIMD_SSE2
+        #include <emmintrin.h>
+    #endif
+#endif
+
+/* Implements (or tries to) an unified way of working with containers of several types: maps, vectors, multimaps,...
+    in a way all of them could inherit from the same interface and be treated the same way.
+*/
+
+namespace core {
+    namespace utils {
+
+        /* Define exceptions for this class
+            * object_not_found: no object found
+            * multiple_objects_found: multiple objects found
+        */
+        class object_not_found : public std::runtime_error {
+            public:
+                object_not_found(const std::string& id) : std::runtime_error(std::string("No object found for id '") + id +"'") {};
+            };
+
+        class multiple_objects_found : public std::runtime_error {
+            public:
+                multiple_objects_found(const std::string& id) : std::runtime_error(std::string("Multiple objects found for id '") + id + "'") {};
+            };
+
+        /* Result of looking for an object by its id:
+            * status: found, not found or multiple objects found for the id.
+            * object: the object (only if found).
+        */
+        enum class qs_status {
+            found = 0,
+            not_found = -1,
+            multiple_found = -2
+            };
+
+        template <class T>
+        struct qs_lookup {
+            qs_lookup() : status(qs_status::not_found), object(nullptr) {};
+            qs_lookup(qs_status status, const T* object = nullptr) : status(status), object(object) {};
+
+            explicit operator bool() const { return status == qs_status::found; };
+
+            qs_status status;
+            const T* object;
+            };
+
+        /* Counters for the hot paths of a qs_manager, they are enabled defining QS_MANAGER_STATS (and QS_MANAGER_STATS_LATENCY
+            for the latency histogram of lookups), otherwise every call compiles to nothing:
+            * lookups: ids looked up ('get', 'try_get', 'get_many').
+            * compared: elements compared by linear scans on vectors.
+            * snapshot_rebuilds: copies of the data from containers that implement 'void all(Container&) const'.
+            * index_rebuilds: times the index (or the key column) of a vector was built.
+            * bytes_copied: bytes copied into snapshots and into the vectors returned by 'all' (sizeof, not deep size).
+            * exceptions: exceptions thrown by 'get'.
+            * latency[i]: lookups that took [2^i, 2^(i+1)) nanoseconds.
+        */
+        struct qs_manager_stats_values {
+            enum { latency_buckets = 32 };
+            std::size_t lookups;
+            std::size_t compared;
+            std::size_t snapshot_rebuilds;
+            std::size_t index_rebuilds;
+            std::size_t bytes_copied;
+            std::size_t exceptions;
+            std::size_t latency[latency_buckets];
+
+            void dump(std::ostream& os) const {
+                os << "lookups=" << lookups << " compared=" << compared << " snapshot_rebuilds=" << snapshot_rebuilds
+                   << " index_rebuilds=" << index_rebuilds << " bytes_copied=" << bytes_copied << " exceptions=" << exceptions;
+                for (std::size_t i = 0; i < latency_buckets; ++i) {
+                    if (latency[i]) {
+                        os << " latency_" << (std::size_t(1) << i) << "ns=" << latency[i];
+                        }
+                    }
+                os << std::endl;
+                };
+            };
+
+#ifdef QS_MANAGER_STATS
+        class qs_manager_stats {
+            public:
+                qs_manager_stats() { this->reset(); };
+                qs_manager_stats(const qs_manager_stats&) { this->reset(); }; // counters belong to each manager
+                qs_manager_stats& operator=(const qs_manager_stats&) { return *this; };
+
+                void lookup(std::size_t n = 1) const { _lookups.fetch_add(n, std::memory_order_relaxed); };
+                void compared(std::size_t n) const { _compared.fetch_add(n, std::memory_order_relaxed); };
+                void snapshot_rebuild(std::size_t bytes) const {
+                    _snapshot_rebuilds.fetch_add(1, std::memory_order_relaxed);
+                    this->copied(bytes);
+                    };
+                void index_rebuild() const { _index_rebuilds.fetch_add(1, std::memory_order_relaxed); };
+                void copied(std::size_t bytes) const { _bytes_copied.fetch_add(bytes, std::memory_order_relaxed); };
+                void exception() const { _exceptions.fetch_add(1, std::memory_order_relaxed); };
+                void latency(std::size_t ns) const {
+                    std::size_t bucket = 0;
+                    while (ns >>= 1) {
+                        ++bucket;
+                        }
+                    _latency[(std::min)(bucket, std::size_t(qs_manager_stats_values::latency_buckets - 1))].fetch_add(1, std::memory_order_relaxed);
+                    };
+
+                qs_manager_stats_values values() const {
+                    qs_manager_stats_values ret;
+                    ret.lookups = _lookups.load(std::memory_order_relaxed);
+                    ret.compared = _compared.load(std::memory_order_relaxed);
+                    ret.snapshot_rebuilds = _snapshot_rebuilds.load(std::memory_order_relaxed);
+                    ret.index_rebuilds = _index_rebuilds.load(std::memory_order_relaxed);
+                    ret.bytes_copied = _bytes_copied.load(std::memory_order_relaxed);
+                    ret.exceptions = _exceptions.load(std::memory_order_relaxed);
+                    for (std::size_t i = 0; i < qs_manager_stats_values::latency_buckets; ++i) {
+                        ret.latency[i] = _latency[i].load(std::memory_order_relaxed);
+                        }
+                    return ret;
+                    };
+                void reset() {
+                    _lookups = 0;
+                    _compared = 0;
+                    _snapshot_rebuilds = 0;
+                    _index_rebuilds = 0;
+                    _bytes_copied = 0;
+                    _exceptions = 0;
+                    for (std::size_t i = 0; i < qs_manager_stats_values::latency_buckets; ++i) {
+                        _latency[i] = 0;
+                        }
+                    };
+                void dump(std::ostream& os) const {
+                    this->values().dump(os);
+                    };
+
+    #ifdef QS_MANAGER_STATS_LATENCY
+                // Measures the latency of a lookup during its lifetime
+                class timer {
+                    public:
+                        explicit timer(const qs_manager_stats& stats) : _stats(stats), _start(std::chrono::steady_clock::now()) {};
+                        ~timer() {
+                            _stats.latency(std::size_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count()));
+                            };
+                    private:
+                        const qs_manager_stats& _stats;
+                        std::chrono::steady_clock::time_point _start;
+                    };
+    #else
+                struct timer {
+                    explicit timer(const qs_manager_stats&) {};
+                    };
+    #endif
+
+            private:
+                mutable std::atomic<std::size_t> _lookups;
+                mutable std::atomic<std::size_t> _compared;
+                mutable std::atomic<std::size_t> _snapshot_rebuilds;
+                mutable std::atomic<std::size_t> _index_rebuilds;
+                mutable std::atomic<std::size_t> _bytes_copied;
+                mutable std::atomic<std::size_t> _exceptions;
+                mutable std::atomic<std::size_t> _latency[qs_manager_stats_values::latency_buckets];
+            };
+#else
+        class qs_manager_stats {
+            public:
+                void lookup(std::size_t = 1) const {};
+                void compared(std::size_t) const {};
+                void snapshot_rebuild(std::size_t) const {};
+                void index_rebuild() const {};
+                void copied(std::size_t) const {};
+                void exception() const {};
+                void latency(std::size_t) const {};
+
+                qs_manager_stats_values values() const {
+                    qs_manager_stats_values ret = qs_manager_stats_values();
+                    return ret;
+                    };
+                void reset() {};
+                void dump(std::ostream& os) const {
+                    os << "qs_manager stats are disabled, define QS_MANAGER_STATS to enable them" << std::endl;
+                    };
+
+                struct timer {
+                    explicit timer(const qs_manager_stats&) {};
+                    };
+            };
+#endif
+
+        /* Memory for the containers a qs_manager builds for itself: the index and the key column ('use_index', 'use_column'),
+            secondary indexes ('index_by') and their table of objects. Same interface as std::pmr::memory_resource, see
+            'qs_monotonic_resource' and 'qs_pmr_resource'. The resource must outlive the manager.
+            Copies of the data keep std::allocator: the vector returned by 'qs_manager::all()' and the copies filled by
+            containers that implement 'void all(Container&) const' have the types those signatures fix. They are reused
+            from one call to the next, so they only allocate when the data grows.
+        */
+        class qs_memory_resource {
+            public:
+                virtual ~qs_memory_resource() {};
+
+                void* allocate(std::size_t bytes, std::size_t alignment) {
+                    return this->do_allocate(bytes, alignment);
+                    };
+                void deallocate(void* p, std::size_t bytes, std::size_t alignment) {
+                    this->do_deallocate(p, bytes, alignment);
+                    };
+
+            protected:
+                virtual void* do_allocate(std::size_t bytes, std::size_t alignment) = 0;
+                virtual void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) = 0;
+            };
+
+        // Default resource: operator new/delete
+        class qs_new_delete_resource : public qs_memory_resource {
+            public:
+                static qs_memory_resource* instance() {
+                    static qs_new_delete_resource resource;
+                    return &resource;
+                    };
+
+            protected:
+                void* do_allocate(std::size_t bytes, std::size_t) {
+                    return ::operator new(bytes);
+                    };
+                void do_deallocate(void* p, std::size_t, std::size_t) {
+                    ::operator delete(p);
+                    };
+            };
+
+        // Arena: memory is taken from blocks (each one twice the previous) and only given back by 'release' or the destructor,
+        //  so allocating is almost free. Use one per request (and per thread, it is not thread safe) and release it after the
+        //  managers using it are gone.
+        class qs_monotonic_resource : public qs_memory_resource {
+            public:
+                explicit qs_monotonic_resource(std::size_t block_size = 64*1024, qs_memory_resource* upstream = qs_new_delete_resource::instance())
+                    : _block_size(block_size), _next_size(block_size), _upstream(upstream), _current(nullptr), _left(0) {};
+                ~qs_monotonic_resource() {
+                    this->release();
+                    };
+
+                void release() {
+                    for (std::vector<std::pair<char*, std::size_t> >::const_iterator it = _blocks.begin(); it != _blocks.end(); ++it) {
+                        _upstream->deallocate(it->first, it->second, alignof(std::max_align_t));
+                        }
+                    _blocks.clear();
+                    _next_size = _block_size;
+                    _current = nullptr;
+                    _left = 0;
+                    };
+
+            protected:
+                void* do_allocate(std::size_t bytes, std::size_t alignment) {
+                    std::size_t padding = this->padding(alignment);
+                    if (_current == nullptr || padding + bytes > _left) {
+                        std::size_t size = (std::max)(_next_size, bytes + alignment);
+                        _current = static_cast<char*>(_upstream->allocate(size, alignof(std::max_align_t)));
+                        _blocks.push_back(std::make_pair(_current, size));
+                        _left = size;
+                        _next_size *= 2;
+                        padding = this->padding(alignment);
+                        }
+                    void* ret = _current + padding;
+                    _current += padding + bytes;
+                    _left -= padding + bytes;
+                    return ret;
+                    };
+                void do_deallocate(void*, std::size_t, std::size_t) {};
+
+                std::size_t padding(std::size_t alignment) const {
+                    return (alignment - reinterpret_cast<std::uintptr_t>(_current) % alignment) % alignment;
+                    };
+
+            private:
+                qs_monotonic_resource(const qs_monotonic_resource&);
+                qs_monotonic_resource& operator=(const qs_monotonic_resource&);
+
+                std::size_t _block_size;
+                std::size_t _next_size;
+                qs_memory_resource* _upstream;
+                std::vector<std::pair<char*, std::size_t> > _blocks;
+                char* _current;
+                std::size_t _left;
+            };
+
+#ifdef QS_MANAGER_HAS_PMR
+        // Any std::pmr::memory_resource (monotonic_buffer_resource, pool resources,...) as a qs_memory_resource
+        class qs_pmr_resource : public qs_memory_resource {
+            public:
+                explicit qs_pmr_resource(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : _resource(resource) {};
+
+            protected:
+                void* do_allocate(std::size_t bytes, std::size_t alignment) {
+                    return _resource->allocate(bytes, alignment);
+                    };
+                void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) {
+                    _resource->deallocate(p, bytes, alignment);
+                    };
+
+            private:
+                std::pmr::memory_resource* _resource;
+            };
+#endif
+
+        // Allocator over a qs_memory_resource (like std::pmr::polymorphic_allocator), containers move and swap it with their data
+        template <class U>
+        class qs_allocator {
+            public:
+                typedef U value_type;
+                typedef std::true_type propagate_on_container_move_assignment;
+                typedef std::true_type propagate_on_container_swap;
+
+                qs_allocator(qs_memory_resource* resource = qs_new_delete_resource::instance()) : _resource(resource) {};
+                template <class Other>
+                qs_allocator(const qs_allocator<Other>& other) : _resource(other.resource()) {};
+
+                U* allocate(std::size_t n) {
+                    return static_cast<U*>(_resource->allocate(n*sizeof(U), alignof(U)));
+                    };
+                void deallocate(U* p, std::size_t n) {
+                    _resource->deallocate(p, n*sizeof(U), alignof(U));
+                    };
+
+                qs_memory_resource* resource() const {
+                    return _resource;
+                    };
+                template <class Other>
+                bool operator==(const qs_allocator<Other>& other) const {
+                    return _resource == other.resource();
+                    };
+                template <class Other>
+                bool operator!=(const qs_allocator<Other>& other) const {
+                    return _resource != other.resource();
+                    };
+
+            private:
+                qs_memory_resource* _resource;
+            };
+
+        /* Containers may tell the managers attached to them what changed, so they update the data they copied and the
+            indexes they built instead of taking everything again: implement 'void attach(qs_observer<T, ID>*) const' and
+            'void detach(qs_observer<T, ID>*) const' and call every attached observer after each change. Objects inserted
+            in vector containers go to the end, the rest of changes keep the order, and the objects of maps read in place
+            don't move (as in std::map and std::unordered_map). A container that notifies its changes doesn't need
+            'generation()' to let managers reuse their copies. Each change costs O(log n) to the secondary indexes
+            ('qs_manager::index_by'), except in multimaps, sorted vectors and vectors read in place without 'use_index'
+            for erase and update, that rebuild them.
+        */
+        template <class T, class ID>
+        class qs_observer {
+            public:
+                virtual ~qs_observer() {};
+
+                virtual void on_insert(const ID& id, const T& item) = 0;
+                virtual void on_erase(const ID& id) = 0;
+                virtual void on_update(const ID& id, const T& item) = 0;
+            };
+
+        template <class T, class TContainer, class ID> class qs_manager; // forward declaration
+
+        namespace qs_manager_implementation {
+            /* Functions the user may overload for their own types to enable some features:
+                * bool operator==(const T&, const ID&): needed to 'get' objects from vector containers.
+                * Key key_of(const T&): returns the key of an object (it may be the ID itself), vector containers
+                    compare keys instead of calling 'operator==' and they can be indexed ('use_index').
+                * bool to_key(const ID&, Key&): converts an id into a key, returns false if it cannot be converted.
+                    Needed only if ID is not convertible to Key, it is called just once per query.
+                They must be declared before including this header (they are looked up when templates are defined).
+            */
+            struct not_implemented {};
+            void operator==(const not_implemented&, const not_implemented&);
+            void key_of(const not_implemented&);
+            void to_key(const not_implemented&, not_implemented&);
+            }
+
+        /* Range over the objects in a container, it yields 'const T&' directly from the underlying
+            vector or map values without copying them.
+        */
+        template <class Iterator>
+        class qs_view {
+            public:
+                typedef Iterator const_iterator;
+                typedef Iterator iterator;
+
+                qs_view(Iterator begin, Iterator end, std::size_t size) : _begin(begin), _end(end), _size(size) {};
+
+                Iterator begin() const { return _begin; };
+                Iterator end() const { return _end; };
+                std::size_t size() const { return _size; };
+                bool empty() const { return _size == 0; };
+
+            protected:
+                Iterator _begin, _end;
+                std::size_t _size;
+            };
+
+        // Batches of (at most) 'size' objects of a view, each one is a view too so nothing is copied:
+        //  'for (auto& batch : manager.chunks(4096)) { for (const T& item : batch) {...} }'
+        template <class View>
+        class qs_chunks {
+            public:
+                typedef qs_view<typename View::const_iterator> chunk_type;
+
+                class const_iterator {
+                    public:
+                        typedef std::forward_iterator_tag iterator_category;
+                        typedef chunk_type value_type;
+                        typedef std::ptrdiff_t difference_type;
+                        typedef const chunk_type* pointer;
+                        typedef const chunk_type& reference;
+
+                        const_iterator(typename View::const_iterator begin, std::size_t remaining, std::size_t size)
+                            : _chunk(begin, begin, 0), _remaining(remaining), _size(size) {
+                            this->__next(begin);
+                            };
+
+                        reference operator*() const { return _chunk; };
+                        pointer operator->() const { return &_chunk; };
+                        const_iterator& operator++() {
+                            _remaining -= _chunk.size();
+                            this->__next(_chunk.end());
+                            return *this;
+                            };
+                        const_iterator operator++(int) { const_iterator tmp(*this); ++(*this); return tmp; };
+                        bool operator==(const const_iterator& other) const { return _remaining == other._remaining; };
+                        bool operator!=(const const_iterator& other) const { return _remaining != other._remaining; };
+
+                    private:
+                        void __next(typename View::const_iterator begin) {
+                            std::size_t size = (std::min)(_size, _remaining);
+                            typename View::const_iterator end = begin;
+                            std::advance(end, size);
+                            _chunk = chunk_type(begin, end, size);
+                            };
+
+                        chunk_type _chunk;
+                        std::size_t _remaining;
+                        std::size_t _size;
+                    };
+
+            public:
+                qs_chunks(const View& view, std::size_t size) : _view(view), _size((std::max)(size, std::size_t(1))) {};
+
+                const_iterator begin() const {
+                    return const_iterator(_view.begin(), _view.size(), _size);
+                    };
+                const_iterator end() const {
+                    return const_iterator(_view.end(), 0, _size);
+                    };
+                // Number of batches
+                std::size_t size() const {
+                    return (_view.size() + _size - 1) / _size;
+                    };
+                bool empty() const {
+                    return _view.empty();
+                    };
+
+            protected:
+                View _view;
+                std::size_t _size;
+            };
+
+        /* Sorted contiguous storage of (key, object) pairs: a cache friendly alternative to std::map for read-mostly data.
+            Lookups are branchless binary searches; objects with the same key are kept together in insertion order (a
+            'qs_manager' reports them as 'multiple_found'). 'qs_manager::freeze' builds one from any source.
+        */
+        template <class Key, class T, class Compare = std::less<Key> >
+        class qs_sorted_vector {
+            public:
+                typedef Key key_type;
+                typedef T mapped_type;
+                typedef std::pair<Key, T> value_type;
+                typedef Compare key_compare;
+                typedef typename std::vector<value_type>::const_iterator const_iterator;
+                typedef const_iterator iterator;
+                typedef typename std::vector<value_type>::size_type size_type;
+
+            public:
+                explicit qs_sorted_vector(const Compare& comp = Compare()) : _comp(comp) {};
+                template <class InputIterator>
+                qs_sorted_vector(InputIterator first, InputIterator last, const Compare& comp = Compare()) : _data(first, last), _comp(comp) {
+                    this->__sort(0);
+                    };
+                explicit qs_sorted_vector(std::vector<value_type>&& data, const Compare& comp = Compare()) : _data(std::move(data)), _comp(comp) {
+                    this->__sort(0);
+                    };
+
+                const_iterator begin() const { return _data.begin(); };
+                const_iterator end() const { return _data.end(); };
+                size_type size() const { return _data.size(); };
+                bool empty() const { return _data.empty(); };
+                key_compare key_comp() const { return _comp; };
+
+                void clear() { _data.clear(); };
+                void reserve(size_type size) { _data.reserve(size); };
+                void swap(qs_sorted_vector& other) {
+                    _data.swap(other._data);
+                    std::swap(_comp, other._comp);
+                    };
+
+                // Inserting one by one is O(n) each, insert ranges instead
+                iterator insert(const value_type& value) {
+                    return _data.insert(this->upper_bound(value.first), value);
+                    };
+                template <class InputIterator>
+                void insert(InputIterator first, InputIterator last) {
+                    size_type prev = _data.size();
+                    _data.insert(_data.end(), first, last);
+                    this->__sort(prev);
+                    };
+                size_type erase(const key_type& key) {
+                    std::pair<const_iterator, const_iterator> range = this->equal_range(key);
+                    size_type count = size_type(std::distance(range.first, range.second));
+                    _data.erase(range.first, range.second);
+                    return count;
+                    };
+
+                const_iterator lower_bound(const key_type& key) const {
+                    const Compare& comp = _comp;
+                    return this->__search([&comp, &key](const key_type& item) { return comp(item, key); });
+                    };
+                const_iterator upper_bound(const key_type& key) const {
+                    const Compare& comp = _comp;
+                    return this->__search([&comp, &key](const key_type& item) { return !comp(key, item); });
+                    };
+                std::pair<const_iterator, const_iterator> equal_range(const key_type& key) const {
+                    return std::make_pair(this->lower_bound(key), this->upper_bound(key));
+                    };
+                const_iterator find(const key_type& key) const {
+                    const_iterator it = this->lower_bound(key);
+                    return (it == _data.end() || _comp(key, it->first)) ? _data.end() : it;
+                    };
+                size_type count(const key_type& key) const {
+                    std::pair<const_iterator, const_iterator> range = this->equal_range(key);
+                    return size_type(std::distance(range.first, range.second));
+                    };
+
+            protected:
+                // First item that doesn't go 'before' the key, the loop has no branches on the comparison (it compiles to a
+                //  conditional move) so it doesn't suffer from mispredictions.
+                template <class Before>
+                const_iterator __search(const Before& before) const {
+                    size_type n = _data.size();
+                    if (n == 0) {
+                        return _data.end();
+                        }
+                    const value_type* base = _data.data();
+                    while (n > 1) {
+                        size_type half = n / 2;
+                        base = before(base[half].first) ? base + half : base;
+                        n -= half;
+                        }
+                    return _data.begin() + ((base - _data.data()) + (before(base->first) ? 1 : 0));
+                    };
+
+                // Sorts the items from 'prev' on and merges them with the previous ones (already sorted)
+                void __sort(size_type prev) {
+                    const Compare& comp = _comp;
+                    auto by_key = [&comp](const value_type& lhs, const value_type& rhs) { return comp(lhs.first, rhs.first); };
+                    typename std::vector<value_type>::iterator middle = _data.begin() + prev;
+                    if (!std::is_sorted(middle, _data.end(), by_key)) {
+                        std::stable_sort(middle, _data.end(), by_key);
+                        }
+                    std::inplace_merge(_data.begin(), middle, _data.end(), by_key);
+                    };
+
+                std::vector<value_type> _data;
+                Compare _comp;
+            };
+
+        namespace _private {
+            // Condition for a 'static_assert' that fails only if the template that contains it is instantiated
+            template <class T>
+            struct qs_always_false : std::false_type {};
+
+            /* Some private for easier template implementation on qs_manager.
+            */
+            // The object found or the exception for the status of the lookup
+            // Text of an id for the exceptions, ids without 'operator<<' are shown by type
+            template <typename ID>
+            struct is_streamable {
+                template <typename ID1>
+                static decltype(std::declval<std::ostream&>() << std::declval<const ID1&>()) test(int);
+                template <typename>
+                static void test(...);
+
+                enum { value = !std::is_void<decltype(test<ID>(0))>::value };
+                };
+
+            template <class ID>
+            std::string id_string(const ID& id, typename std::enable_if<is_streamable<ID>::value>::type* = nullptr) {
+                std::ostringstream os;
+                os << id;
+                return os.str();
+                };
+            template <class ID>
+            std::string id_string(const ID&, typename std::enable_if<!is_streamable<ID>::value>::type* = nullptr) {
+                return std::string("<") + typeid(ID).name() + ">";
+                };
+
+            template <class T, class ID>
+            const T& object_or_throw(const qs_lookup<T>& found, const ID& id, const qs_manager_stats& stats) {
+                switch (found.status) {
+                    case qs_status::not_found:
+                        stats.exception();
+                        throw object_not_found(id_string(id));
+                    case qs_status::multiple_found:
+                        stats.exception();
+                        throw multiple_objects_found(id_string(id));
+                    default:
+                        return *found.object;
+                    }
+                };
+
+            // Adds an object found for an id to its lookup result
+            template <class T>
+            void add_match(qs_lookup<T>& result, const T& item) {
+                result = (result.status == qs_status::not_found) ? qs_lookup<T>(qs_status::found, &item) : qs_lookup<T>(qs_status::multiple_found);
+                };
+
+            template <typename All_Container>
+            struct check_all_to_container {
+                template <typename T, void (T::*)(All_Container&) const = &T::all>
+                struct get {};
+                };
+
+            template <typename T, typename ContainerType>
+            struct has_all_to_container : has_member<T, check_all_to_container<ContainerType> > {};
+            
+            template <typename All_Container>
+            struct check_all_as_container {
+                template <typename T, const All_Container& (T::*)() const = &T::all>
+                struct get {};
+                };
+
+            template <typename T, typename ContainerType>
+            struct has_all_as_container : has_member<T, check_all_as_container<ContainerType> > {};
+
+            /* Containers may implement 'std::size_t generation() const' returning a value that changes
+                every time their data changes, so qs_manager can reuse the data it copied or indexed.
+            */
+            struct check_generation {
+                template <typename T, std::size_t (T::*)() const = &T::generation>
+                struct get {};
+                };
+
+            template <typename T>
+            struct has_generation : has_member<T, check_generation> {};
+
+            // Containers that notify their changes (see 'qs_observer')
+            template <class T, class ID>
+            struct check_attach {
+                template <typename C, void (C::*)(qs_observer<T, ID>*) const = &C::attach>
+                struct get {};
+                };
+
+            template <class T, class ID>
+            struct check_detach {
+                template <typename C, void (C::*)(qs_observer<T, ID>*) const = &C::detach>
+                struct get {};
+                };
+
+            template <class ClassToTest, class T, class ID>
+            struct has_observers : std::integral_constant<bool, has_member<ClassToTest, check_attach<T, ID> >::value && has_member<ClassToTest, check_detach<T, ID> >::value> {};
+
+            // Base of the managers over containers that notify their changes, nothing (and no vtable) for the rest
+            struct qs_manager_no_observer {};
+
+            template <class ClassToTest, class T, class ID>
+            struct qs_manager_observer_base {
+                typedef typename std::conditional<has_observers<ClassToTest, T, ID>::value, qs_observer<T, ID>, qs_manager_no_observer>::type type;
+                };
+
+            enum class qs_change {
+                insert,
+                erase,
+                update
+                };
+
+            // Where a change notified by the container happened, for the secondary indexes (see 'qs_manager_indexes'): the
+            //  position of the object in vectors (before the change for erase and update), the object after the change in
+            //  maps. Unknown if the manager cannot tell, then the indexes are rebuilt.
+            template <class T>
+            struct qs_change_place {
+                qs_change_place() : known(false), position(0), object(nullptr) {};
+
+                static qs_change_place at(std::size_t position) {
+                    qs_change_place ret;
+                    ret.known = true;
+                    ret.position = position;
+                    return ret;
+                    };
+                static qs_change_place of(const T* object) {
+                    qs_change_place ret;
+                    ret.known = true;
+                    ret.object = object;
+                    return ret;
+                    };
+
+                bool known;
+                std::size_t position;
+                const T* object;
+                };
+
+            // Keeps track of the generation of a container. If the container has no generation and it doesn't notify its
+            //  changes, every 'update' is a new revision (see 'known').
+            template <class ClassToTest, typename Enable = void>
+            class qs_manager_generation {
+                public:
+                    qs_manager_generation() : _revision(0), _observed(false), _stale(false) {};
+
+                    bool update(const ClassToTest&) const {
+                        if (!_observed) {
+                            ++_revision; // the data is taken again, it may have changed
+                            return true;
+                            }
+                        if (_revision == 0 || _stale) {
+                            _stale = false;
+                            ++_revision;
+                            return true;
+                            }
+                        return false;
+                        };
+                    std::size_t revision() const { return _revision; };
+                    // The changes of the container can be known, else 'update' always returns true
+                    bool known() const { return _observed; };
+
+                    // The container notifies its changes: the data changes only with them (or 'invalidate')
+                    void observe() { _observed = true; };
+                    // A change was applied to the data taken from the container, returns the new revision
+                    std::size_t sync(const ClassToTest&) const {
+                        if (_revision != 0) {
+                            ++_revision;
+                            }
+                        return _revision;
+                        };
+                    void invalidate() const { _stale = true; };
+
+                    // Generation of the container, '0' if unknown
+                    static std::size_t of(const ClassToTest&) { return 0; };
+
+                private:
+                    mutable std::size_t _revision;
+                    bool _observed;
+                    mutable bool _stale;
+                };
+
+            template <class ClassToTest>
+            class qs_manager_generation<ClassToTest,
+                typename std::enable_if< has_generation<ClassToTest>::value >::type
+                > {
+                public:
+                    qs_manager_generation() : _generation(0), _revision(0), _stale(false) {};
+
+                    // Returns true if the container changed since the last call
+                    bool update(const ClassToTest& container) const {
+                        std::size_t generation = container.generation();
+                        if (_revision == 0 || _stale || generation != _generation) {
+                            _generation = generation;
+                            _stale = false;
+                            ++_revision;
+                            return true;
+                            }
+                        return false;
+                        };
+                    std::size_t revision() const { return _revision; };
+                    bool known() const { return true; };
+
+                    void observe() {};
+                    // A change was applied to the data taken from the container, returns the new revision
+                    std::size_t sync(const ClassToTest& container) const {
+                        if (_revision != 0) {
+                            _generation = container.generation();
+                            ++_revision;
+                            }
+                        return _revision;
+                        };
+                    void invalidate() const { _stale = true; };
+
+                    static std::size_t of(const ClassToTest& container) { return container.generation(); };
+
+                private:
+                    mutable std::size_t _generation;
+                    mutable std::size_t _revision;
+                    mutable bool _stale;
+                };
+
+            // Copy of the data of a container that implements 'void all(Container&) const', it is only updated if the container changed.
+            template <class ClassToTest, class Container>
+            class qs_manager_snapshot {
+                public:
+                    qs_manager_snapshot() : _loaded(false) {};
+
+                    const Container& update(const ClassToTest& container, const qs_manager_stats& stats) const {
+                        if (_generation.update(container)) {
+                            container.all(_data);
+                            _loaded = true;
+                            stats.snapshot_rebuild(_data.size()*sizeof(typename Container::value_type));
+                            }
+                        return _data;
+                        };
+                    // Same as 'update' but if the container cannot tell when it changes the copy is only taken the first time,
+                    //  so that several calls see the same data ('begin' and 'end' of a loop)
+                    const Container& load(const ClassToTest& container, const qs_manager_stats& stats) const {
+                        if (_loaded && !_generation.known()) {
+                            return _data;
+                            }
+                        return this->update(container, stats);
+                        };
+                    const Container& data() const { return _data; };
+                    std::size_t revision() const { return _generation.revision(); };
+
+                    // Changes notified by the container (see 'qs_observer') are applied to the copy, if there is one ('revision() != 0')
+                    Container& changes() const { return _data; };
+                    std::size_t sync(const ClassToTest& container) const { return _generation.sync(container); };
+                    void invalidate() const { _generation.invalidate(); };
+                    void observe() { _generation.observe(); };
+
+                private:
+                    qs_manager_generation<ClassToTest> _generation;
+                    mutable Container _data;
+                    mutable bool _loaded;
+                };
+
+            // Revision of the data something (an index, a key column,...) was built from: it is up to date only while the
+            //  revision of the data is known and it is the same. If it is unknown ('0') the data may have changed at any time,
+            //  but a vector is taken as the same data while it keeps its address and its size (other changes need 'reindex').
+            class qs_manager_built_revision {
+                public:
+                    qs_manager_built_revision() : _revision(0), _data(nullptr), _size(0) {};
+
+                    bool current(std::size_t revision) const { return revision != 0 && revision == _revision; };
+                    template <class T>
+                    bool current(const std::vector<T>& all, std::size_t revision) const {
+                        if (revision != 0) {
+                            return this->current(revision);
+                            }
+                        return _revision == 0 && _data != nullptr && _data == all.data() && _size == all.size();
+                        };
+                    void built(std::size_t revision) const { _revision = revision; };
+                    template <class T>
+                    void built(const std::vector<T>& all, std::size_t revision) const {
+                        _revision = revision;
+                        _data = all.data();
+                        _size = all.size();
+                        };
+                    void invalidate() const {
+                        _revision = 0;
+                        _data = nullptr;
+                        };
+
+                private:
+                    mutable std::size_t _revision;
+                    mutable const void* _data; // vector the revision was unknown for
+                    mutable std::size_t _size;
+                };
+            
+            // To implement
+            template <class T, class ID, class ClassToTest, typename Enable = void>
+            class qs_manager_get_impl {
+                static_assert(qs_always_false<ClassToTest>::value, "<ClassToTest> is not implemented as a valid container for 'qs_manager'");
+                public:
+                    typedef qs_view<typename std::vector<T>::const_iterator> view_type;
+                    typedef void snapshot_store;
+                    typedef std::false_type vector_getter;
+
+                    explicit qs_manager_get_impl(const ClassToTest&) {};
+                };
+           
+/**********************
+    VECTORS
+***********************/
+            template <class T, class ID> class qs_manager_vector_store; // forward declaration
+
+            /* Vector implementations: the adapter ('Derived') provides 'all()' and 'all(std::vector<T>&)', they are
+                called statically (CRTP) so nothing is virtual and the adapter is inlined in every lookup.
+            */
+            template <class Derived, class T, class ID, typename Enable = void>
+            class qs_manager_getter_vector {
+                public:
+                    typedef qs_view<typename std::vector<T>::const_iterator> view_type;
+                    typedef qs_manager_vector_store<T, ID> snapshot_store;
+                    typedef std::true_type vector_getter;
+
+                    const T& get(const ID&) const {
+                        static_assert(qs_always_false<T>::value, "To use 'get' on qs_manager with a vector implementation you must define 'bool ::core::qs_manager_implementation::operator==(const T&, const ID&)' or 'Key ::core::utils::qs_manager_implementation::key_of(const T&)' function ");
+                        }
+
+                    const qs_manager_stats& stats() const {
+                        return _stats;
+                        };
+
+                protected:
+                    void __memory_resource(qs_memory_resource*) {};
+                    void __load() const {};
+                    void __locate_changes() const {};
+                    qs_lookup<T> __find_change(const std::vector<T>&, const ID&, std::size_t) const { return qs_lookup<T>(); };
+                    void __apply_change(qs_change, const ID&, const std::vector<T>&, std::size_t, std::size_t) const {};
+                    std::size_t __position_of_change(const ID&, std::size_t) const { return std::size_t(-1); }; // not found
+
+                    qs_manager_stats _stats;
+                };
+            
+            
+            // SFINAE comparison operator for 'bool operator==(const T&, const ID&)'
+            struct dummy {};
+            void operator==(const dummy&, const dummy&);
+
+            // bool operator==(const int&, const std::string&); // This is detected. <<IEXCL>>namespaces!
+
+            template <typename T, typename ID>
+            struct is_operator_available {
+                template <typename T1, typename ID1>
+                static decltype(::core::utils::qs_manager_implementation::operator==(T1(), ID1())) test(int, int);
+                template <typename, typename>
+                static void test(...);
+
+                enum { value = !std::is_void<decltype(test<T, ID>(0, 0))>::value};
+                };
+            
+
+            // SFINAE for 'Key key_of(const T&)', type is 'void' if not available
+            template <typename T>
+            struct key_of_type {
+                template <typename T1>
+                static decltype(::core::utils::qs_manager_implementation::key_of(std::declval<const T1&>())) test(int);
+                template <typename>
+                static void test(...);
+
+                typedef typename std::decay<decltype(test<T>(0))>::type type;
+                };
+
+            // SFINAE for 'bool to_key(const ID&, Key&)'
+            template <typename ID, typename Key>
+            struct is_to_key_available {
+                template <typename ID1, typename Key1>
+                static decltype(::core::utils::qs_manager_implementation::to_key(std::declval<const ID1&>(), std::declval<Key1&>())) test(int, int);
+                template <typename, typename>
+                static void test(...);
+
+                enum { value = std::is_same<bool, decltype(test<ID, Key>(0, 0))>::value};
+                };
+
+            // Conversion from ids to keys using 'to_key' or an implicit conversion, 'value' is false if none is available.
+            template <typename ID, typename Key>
+            struct qs_manager_id_to_key {
+                enum { value = is_to_key_available<ID, Key>::value || std::is_convertible<ID, Key>::value };
+
+                static bool convert(const ID& id, Key& key) {
+                    return convert(id, key, std::integral_constant<bool, is_to_key_available<ID, Key>::value>());
+                    };
+
+                private:
+                    static bool convert(const ID& id, Key& key, std::true_type) {
+                        return ::core::utils::qs_manager_implementation::to_key(id, key);
+                        };
+                    static bool convert(const ID& id, Key& key, std::false_type) {
+                        key = id;
+                        return true;
+                        };
+                };
+
+            // Keys of the objects (see 'key_of') and conversion from ids, 'value' is false if they are not available.
+            template <typename T, typename ID, typename Enable = void>
+            struct qs_manager_key {
+                enum { value = false };
+                };
+
+            template <typename T, typename ID>
+            struct qs_manager_key<T, ID,
+                typename std::enable_if< !std::is_void<typename key_of_type<T>::type>::value &&
+                                         (is_to_key_available<ID, typename key_of_type<T>::type>::value || std::is_convertible<ID, typename key_of_type<T>::type>::value)
+                                         >::type
+                > {
+                enum { value = true };
+                typedef typename key_of_type<T>::type type;
+
+                static type of(const T& item) {
+                    return ::core::utils::qs_manager_implementation::key_of(item);
+                    };
+
+                static bool from_id(const ID& id, type& key) {
+                    return qs_manager_id_to_key<ID, type>::convert(id, key);
+                    };
+                };
+
+            template <typename T, typename ID>
+            struct is_key_of_available : std::integral_constant<bool, qs_manager_key<T, ID>::value> {};
+
+            /* Slots of the objects of a vector: each object keeps the slot it got when it was added, so erasing one doesn't
+                move the others. The position of an object is the number of live slots before it, counted with a Fenwick
+                tree that is only built on the first erase (until then slot and position are the same), so erasing, adding
+                and finding a position cost O(log n).
+            */
+            class qs_manager_slots {
+                public:
+                    qs_manager_slots() : _slots(0), _erased(0) {};
+
+                    void resource(qs_memory_resource* resource) {
+                        tree_type(qs_allocator<std::size_t>(resource)).swap(_tree);
+                        _slots = _erased = 0;
+                        };
+                    // All the 'size' objects alive, slot = position
+                    void reset(std::size_t size) {
+                        _slots = size;
+                        _erased = 0;
+                        _tree.clear();
+                        };
+                    std::size_t size() const { return _slots - _erased; };
+                    std::size_t erased() const { return _erased; };
+
+                    // New slot for an object added at the end
+                    std::size_t append() {
+                        if (!_tree.empty()) {
+                            std::size_t i = _slots + 1;
+                            _tree.push_back(1 + this->__sum(i - 1) - this->__sum(i - __low(i)));
+                            }
+                        return _slots++;
+                        };
+                    void erase(std::size_t slot) {
+                        if (_tree.empty()) {
+                            _tree.resize(_slots + 1);
+                            for (std::size_t i = 1; i <= _slots; ++i) {
+                                _tree[i] = __low(i);
+                                }
+                            }
+                        for (std::size_t i = slot + 1; i <= _slots; i += __low(i)) {
+                            --_tree[i];
+                            }
+                        ++_erased;
+                        };
+                    bool alive(std::size_t slot) const {
+                        return slot < _slots && (_tree.empty() || this->__sum(slot + 1) != this->__sum(slot));
+                        };
+                    std::size_t position(std::size_t slot) const {
+                        return _tree.empty() ? slot : this->__sum(slot);
+                        };
+                    // Slot of the live object at 'position'
+                    std::size_t slot(std::size_t position) const {
+                        if (_tree.empty()) {
+                            return position;
+                            }
+                        std::size_t slot = 0, rest = position + 1, step = 1;
+                        while (step <= _slots / 2) {
+                            step *= 2;
+                            }
+                        for (; step != 0; step /= 2) {
+                            if (slot + step <= _slots && _tree[slot + step] < rest) {
+                                slot += step;
+                                rest -= _tree[slot];
+                                }
+                            }
+                        return slot;
+                        };
+
+                private:
+                    typedef std::vector<std::size_t, qs_allocator<std::size_t> > tree_type;
+
+                    static std::size_t __low(std::size_t i) { return i & (~i + 1); };
+                    // Live slots among the first 'count'
+                    std::size_t __sum(std::size_t count) const {
+                        std::size_t sum = 0;
+                        for (; count != 0; count -= __low(count)) {
+                            sum += _tree[count];
+                            }
+                        return sum;
+                        };
+
+                    std::size_t _slots;
+                    std::size_t _erased;
+                    tree_type _tree; // 1-based
+                };
+
+            /* Hashed index for vector containers: it maps the key of each item to its slot in the vector (see
+                'qs_manager_slots'), it is built lazily on the first 'get' and it is rebuilt only if the revision of the
+                vector changes (see 'qs_manager_built_revision'). If the revision is unknown it is rebuilt only if the
+                vector moves or its size changes. Items modified in place without a new revision are detected on hits,
+                other in place modifications require a call to 'reindex'.
+            */
+            struct qs_manager_vector_index_base {
+                static const std::size_t not_found = std::size_t(-1);
+                static const std::size_t duplicated = std::size_t(-2);
+                };
+
+            template <class T, class ID, typename Enable = void>
+            class qs_manager_vector_index : public qs_manager_vector_index_base {
+                public:
+                    explicit qs_manager_vector_index(bool = false) {};
+
+                    void resource(qs_memory_resource*) {};
+                    void apply(qs_change, const ID&, const std::vector<T>&, std::size_t, std::size_t) const {};
+                    std::size_t position(const ID&, std::size_t) const { return not_found; };
+                    void update(const std::vector<T>&, std::size_t, const qs_manager_stats&) const {};
+                    bool enabled() const { return false; };
+                    void enable(bool enable) {
+                        static_assert(qs_always_false<T>::value, "To use an index on qs_manager with a vector implementation you must define 'Key ::core::utils::qs_manager_implementation::key_of(const T&)' function (and 'bool to_key(const ID&, Key&)' if ID is not convertible to Key)");
+                        };
+                    void invalidate() const {};
+                    std::size_t find(const std::vector<T>&, const ID&, std::size_t, const qs_manager_stats&) const { return not_found; };
+                    void build(const std::vector<T>&, std::size_t, const qs_manager_stats&) const {};
+                };
+
+            template <class T, class ID>
+            class qs_manager_vector_index<T, ID,
+                typename std::enable_if< is_key_of_available<T, ID>::value >::type
+                > : public qs_manager_vector_index_base {
+                public:
+                    explicit qs_manager_vector_index(bool enabled = false) : _enabled(enabled) {};
+
+                    // Memory for the index (see 'qs_memory_resource')
+                    void resource(qs_memory_resource* resource) {
+                        _built.invalidate();
+                        index_type(allocator_type(resource)).swap(_index);
+                        _slots.resource(resource);
+                        };
+                    bool enabled() const { return _enabled; };
+                    void enable(bool enable) {
+                        _enabled = enable;
+                        _built.invalidate();
+                        index_type(_index.get_allocator()).swap(_index); // release memory
+                        _slots.reset(0);
+                        };
+                    void invalidate() const {
+                        _built.invalidate();
+                        };
+
+                    std::size_t find(const std::vector<T>& all, const ID& id, std::size_t revision, const qs_manager_stats& stats) const {
+                        key_type key;
+                        if (!qs_manager_key<T, ID>::from_id(id, key)) {
+                            return not_found;
+                            }
+                        if (!_built.current(all, revision)) {
+                            this->build(all, revision, stats);
+                            }
+                        std::size_t pos = this->lookup(key);
+                        if (pos < all.size() && !(qs_manager_key<T, ID>::of(all[pos]) == key)) {
+                            // The item was modified in place, index is outdated.
+                            this->build(all, revision, stats);
+                            pos = this->lookup(key);
+                            }
+                        return pos;
+                        };
+                    // Builds the index if it is enabled and not built for 'revision'
+                    void update(const std::vector<T>& all, std::size_t revision, const qs_manager_stats& stats) const {
+                        if (_enabled && !_built.current(all, revision)) {
+                            this->build(all, revision, stats);
+                            }
+                        };
+
+                    // Position of 'id' in the data of revision 'previous' if the index is built for it (no rebuild, no check),
+                    //  'not_found' otherwise
+                    std::size_t position(const ID& id, std::size_t previous) const {
+                        key_type key;
+                        if (!_enabled || !_built.current(previous) || !qs_manager_key<T, ID>::from_id(id, key)) {
+                            return not_found;
+                            }
+                        return this->lookup(key);
+                        };
+
+                    // Applies a change notified by the container to the index built for revision 'previous', 'all' is the data
+                    //  already changed. Erasing leaves a tombstone in the slots, the other objects keep theirs and nothing is
+                    //  hashed again, the index is rebuilt when tombstones outnumber the objects.
+                    void apply(qs_change change, const ID& id, const std::vector<T>& all, std::size_t previous, std::size_t revision) const {
+                        key_type key;
+                        if (!_enabled || !_built.current(previous) || !qs_manager_key<T, ID>::from_id(id, key)) {
+                            _built.invalidate();
+                            return;
+                            }
+                        typename index_type::iterator it = _index.find(key);
+                        std::size_t slot = (it == _index.end()) ? not_found : it->second;
+                        switch (change) {
+                            case qs_change::insert:
+                                if (all.size() != _slots.size() + 1 || !(qs_manager_key<T, ID>::of(all.back()) == key)) {
+                                    _built.invalidate();
+                                    return;
+                                    }
+                                slot = _slots.append();
+                                if (it == _index.end()) {
+                                    _index.insert(std::make_pair(key, slot));
+                                    }
+                                else {
+                                    it->second = duplicated;
+                                    }
+                                break;
+                            case qs_change::erase:
+                                if (all.size() + 1 != _slots.size() || slot == not_found || slot == duplicated || _slots.erased() >= 16 + all.size()) {
+                                    _built.invalidate();
+                                    return;
+                                    }
+                                _slots.erase(slot);
+                                _index.erase(it);
+                                break;
+                            case qs_change::update:
+                                if (all.size() != _slots.size() || slot == not_found || slot == duplicated
+                                    || !(qs_manager_key<T, ID>::of(all[_slots.position(slot)]) == key)) {
+                                    _built.invalidate();
+                                    return;
+                                    }
+                                break;
+                            }
+                        _built.built(all, revision);
+                        };
+
+                    // Builds the index now ('find' builds it when needed)
+                    void build(const std::vector<T>& all, std::size_t revision, const qs_manager_stats& stats) const {
+                        stats.index_rebuild();
+                        _index.clear();
+                        _index.reserve(all.size());
+                        for (std::size_t i = 0; i < all.size(); ++i) {
+                            std::pair<typename index_type::iterator, bool> ret = _index.insert(std::make_pair(qs_manager_key<T, ID>::of(all[i]), i));
+                            if (!ret.second) {
+                                ret.first->second = duplicated;
+                                }
+                            }
+                        _slots.reset(all.size());
+                        _built.built(all, revision);
+                        };
+
+                private:
+                    typedef typename qs_manager_key<T, ID>::type key_type;
+                    typedef qs_allocator<std::pair<const key_type, std::size_t> > allocator_type;
+                    typedef std::unordered_map<key_type, std::size_t, std::hash<key_type>, std::equal_to<key_type>, allocator_type> index_type;
+
+                    // Position of the object with 'key' (or 'not_found'/'duplicated')
+                    std::size_t lookup(const key_type& key) const {
+                        typename index_type::const_iterator it = _index.find(key);
+                        if (it == _index.end()) {
+                            return not_found;
+                            }
+                        return (it->second == duplicated) ? duplicated : _slots.position(it->second);
+                        };
+
+                    bool _enabled;
+                    qs_manager_built_revision _built;
+                    mutable qs_manager_slots _slots;
+                    mutable index_type _index;
+                };
+
+            // Scan of a column of integral keys looking for one of them: 'count' is the number of matches (up to 2, there is
+            //  no need to go on) and 'first' is the position of the first one. Keys of 4 and 8 bytes are compared several
+            //  at a time with SSE2/AVX2 and the matches are taken from the compare mask.
+            struct qs_column_scan {
+                struct result {
+                    std::size_t count;
+                    std::size_t first;
+                    };
+
+                template <class Key>
+                static result find(const Key* keys, std::size_t size, Key key) {
+                    result ret = {0, 0};
+                    std::size_t i = __find(keys, size, key, ret, std::integral_constant<std::size_t, sizeof(Key)>());
+                    for (; i < size && ret.count < 2; ++i) {
+                        if (keys[i] == key) {
+                            add(1u, i, ret);
+                            }
+                        }
+                    return ret;
+                    };
+
+                protected:
+                    // Adds the matches in 'mask' (bit 'i' is the key at 'offset + i'), returns true once there are many
+                    static bool add(unsigned mask, std::size_t offset, result& ret) {
+                        for (std::size_t bit = 0; mask; ++bit, mask >>= 1) {
+                            if (mask & 1u) {
+                                if (ret.count++ == 0) {
+                                    ret.first = offset + bit;
+                                    }
+                                else {
+                                    return true;
+                                    }
+                                }
+                            }
+                        return false;
+                        };
+
+                    // Returns where the scalar loop has to go on ('size' if it is done)
+                    template <class Key, std::size_t Size>
+                    static std::size_t __find(const Key*, std::size_t, Key, result&, std::integral_constant<std::size_t, Size>) {
+                        return 0;
+                        };
+
+#if defined(QS_MANAGER_SIMD_AVX2)
+                    static unsigned mask(__m256i cmp, std::integral_constant<std::size_t, 4>) { return unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(cmp))); };
+                    static unsigned mask(__m256i cmp, std::integral_constant<std::size_t, 8>) { return unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(cmp))); };
+                    static __m256i compare(const void* keys, __m256i needle, std::integral_constant<std::size_t, 4>) {
+                        return _mm256_cmpeq_epi32(_mm256_loadu_si256(static_cast<const __m256i*>(keys)), needle);
+                        };
+                    static __m256i compare(const void* keys, __m256i needle, std::integral_constant<std::size_t, 8>) {
+                        return _mm256_cmpeq_epi64(_mm256_loadu_si256(static_cast<const __m256i*>(keys)), needle);
+                        };
+                    static __m256i needle(std::int32_t key) { return _mm256_set1_epi32(key); };
+                    static __m256i needle(std::int64_t key) { return _mm256_set1_epi64x(key); };
+
+                    template <class Key, std::size_t Size>
+                    static std::size_t __scan(const Key* keys, std::size_t size, __m256i needle, result& ret, std::integral_constant<std::size_t, Size> tag) {
+                        const std::size_t step = 32 / Size; // keys per register
+                        std::size_t i = 0;
+                        for (; i + 4*step <= size; i += 4*step) {
+                            __m256i a = compare(keys + i, needle, tag), b = compare(keys + i + step, needle, tag);
+                            __m256i c = compare(keys + i + 2*step, needle, tag), d = compare(keys + i + 3*step, needle, tag);
+                            __m256i any = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+                            if (!_mm256_testz_si256(any, any)) {
+                                if (add(mask(a, tag), i, ret) || add(mask(b, tag), i + step, ret) || add(mask(c, tag), i + 2*step, ret) || add(mask(d, tag), i + 3*step, ret)) {
+                                    return size;
+                                    }
+                                }
+                            }
+                        for (; i + step <= size; i += step) {
+                            if (add(mask(compare(keys + i, needle, tag), tag), i, ret)) {
+                                return size;
+                                }
+                            }
+                        return i;
+                        };
+#elif defined(QS_MANAGER_SIMD_SSE2)
+                    static unsigned mask(__m128i cmp, std::integral_constant<std::size_t, 4>) { return unsigned(_mm_movemask_ps(_mm_castsi128_ps(cmp))); };
+                    static unsigned mask(__m128i cmp, std::integral_constant<std::size_t, 8>) { return unsigned(_mm_movemask_pd(_mm_castsi128_pd(cmp))); };
+                    static __m128i compare(const void* keys, __m128i needle, std::integral_constant<std::size_t, 4>) {
+                        return _mm_cmpeq_epi32(_mm_loadu_si128(static_cast<const __m128i*>(keys)), needle);
+                        };
+                    static __m128i compare(const void* keys, __m128i needle, std::integral_constant<std::size_t, 8>) {
+                        // There is no 64 bits compare in SSE2: both halves have to be equal
+                        __m128i cmp = _mm_cmpeq_epi32(_mm_loadu_si128(static_cast<const __m128i*>(keys)), needle);
+                        return _mm_and_si128(cmp, _mm_shuffle_epi32(cmp, _MM_SHUFFLE(2, 3, 0, 1)));
+                        };
+                    static __m128i needle(std::int32_t key) { return _mm_set1_epi32(key); };
+                    static __m128i needle(std::int64_t key) { return _mm_set1_epi64x(key); };
+
+                    template <class Key, std::size_t Size>
+                    static std::size_t __scan(const Key* keys, std::size_t size, __m128i needle, result& ret, std::integral_constant<std::size_t, Size> tag) {
+                        const std::size_t step = 16 / Size; // keys per register
+                        std::size_t i = 0;
+                        for (; i + 4*step <= size; i += 4*step) {
+                            __m128i a = compare(keys + i, needle, tag), b = compare(keys + i + step, needle, tag);
+                            __m128i c = compare(keys + i + 2*step, needle, tag), d = compare(keys + i + 3*step, needle, tag);
+                            if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)))) {
+                                if (add(mask(a, tag), i, ret) || add(mask(b, tag), i + step, ret) || add(mask(c, tag), i + 2*step, ret) || add(mask(d, tag), i + 3*step, ret)) {
+                                    return size;
+                                    }
+                                }
+                            }
+                        for (; i + step <= size; i += step) {
+                            if (add(mask(compare(keys + i, needle, tag), tag), i, ret)) {
+                                return size;
+                                }
+                            }
+                        return i;
+                        };
+#endif
+
+#if defined(QS_MANAGER_SIMD_AVX2) || defined(QS_MANAGER_SIMD_SSE2)
+                    template <class Key>
+                    static std::size_t __find(const Key* keys, std::size_t size, Key key, result& ret, std::integral_constant<std::size_t, 4> tag) {
+                        return __scan(keys, size, needle(std::int32_t(key)), ret, tag);
+                        };
+                    template <class Key>
+                    static std::size_t __find(const Key* keys, std::size_t size, Key key, result& ret, std::integral_constant<std::size_t, 8> tag) {
+                        return __scan(keys, size, needle(std::int64_t(key)), ret, tag);
+                        };
+#endif
+                };
+
+            // Contiguous column with the keys of the objects of a vector: lookups scan it (see 'qs_column_scan') instead of
+            //  calling 'key_of' for every object. Only for integral keys, like the index it is rebuilt if the revision of the
+            //  data changes (or the vector moves or its size changes if the revision is unknown).
+            template <class T, class ID, typename Enable = void>
+            class qs_manager_vector_column : public qs_manager_vector_index_base {
+                public:
+                    explicit qs_manager_vector_column(bool = false) {};
+
+                    void resource(qs_memory_resource*) {};
+                    void apply(qs_change, const ID&, const std::vector<T>&, std::size_t, std::size_t) const {};
+                    bool enabled() const { return false; };
+                    void enable(bool enable) {
+                        static_assert(qs_always_false<T>::value, "To use a key column on qs_manager with a vector implementation 'Key ::core::utils::qs_manager_implementation::key_of(const T&)' must return an integral type");
+                        };
+                    void invalidate() const {};
+                    std::size_t find(const std::vector<T>&, const ID&, std::size_t, const qs_manager_stats&) const { return not_found; };
+                    void build(const std::vector<T>&, std::size_t, const qs_manager_stats&) const {};
+                };
+
+            template <class T, class ID>
+            class qs_manager_vector_column<T, ID,
+                typename std::enable_if< is_key_of_available<T, ID>::value && std::is_integral<typename key_of_type<T>::type>::value >::type
+                > : public qs_manager_vector_index_base {
+                public:
+                    explicit qs_manager_vector_column(bool enabled = false) : _enabled(enabled) {};
+
+                    // Memory for the column (see 'qs_memory_resource')
+                    void resource(qs_memory_resource* resource) {
+                        _built.invalidate();
+                        column_type(qs_allocator<key_type>(resource)).swap(_keys);
+                        };
+                    bool enabled() const { return _enabled; };
+                    void enable(bool enable) {
+                        _enabled = enable;
+                        _built.invalidate();
+                        column_type(_keys.get_allocator()).swap(_keys); // release memory
+                        };
+                    void invalidate() const {
+                        _built.invalidate();
+                        };
+
+                    std::size_t find(const std::vector<T>& all, const ID& id, std::size_t revision, const qs_manager_stats& stats) const {
+                        key_type key;
+                        if (!qs_manager_key<T, ID>::from_id(id, key)) {
+                            return not_found;
+                            }
+                        if (!_built.current(all, revision)) {
+                            this->build(all, revision, stats);
+                            }
+                        stats.compared(_keys.size());
+                        qs_column_scan::result found = qs_column_scan::find(_keys.data(), _keys.size(), key);
+                        if (found.count != 0 && !(qs_manager_key<T, ID>::of(all[found.first]) == key)) {
+                            // The item was modified in place, column is outdated.
+                            this->build(all, revision, stats);
+                            found = qs_column_scan::find(_keys.data(), _keys.size(), key);
+                            }
+                        if (found.count == 0) {
+                            return not_found;
+                            }
+                        return (found.count > 1) ? duplicated : found.first;
+                        };
+
+                    // Applies a change notified by the container to the column built for revision 'previous' (see 'qs_manager_vector_index::apply')
+                    void apply(qs_change change, const ID& id, const std::vector<T>& all, std::size_t previous, std::size_t revision) const {
+                        key_type key;
+                        if (!_enabled || !_built.current(previous) || !qs_manager_key<T, ID>::from_id(id, key)) {
+                            _built.invalidate();
+                            return;
+                            }
+                        if (change == qs_change::insert) {
+                            if (all.size() != _keys.size() + 1 || !(qs_manager_key<T, ID>::of(all.back()) == key)) {
+                                _built.invalidate();
+                                return;
+                                }
+                            _keys.push_back(key);
+                            }
+                        else {
+                            qs_column_scan::result found = qs_column_scan::find(_keys.data(), _keys.size(), key);
+                            std::size_t size = (change == qs_change::erase) ? _keys.size() - 1 : _keys.size();
+                            if (found.count != 1 || all.size() != size) {
+                                _built.invalidate();
+                                return;
+                                }
+                            if (change == qs_change::erase) {
+                                _keys.erase(_keys.begin() + found.first);
+                                }
+                            else if (!(qs_manager_key<T, ID>::of(all[found.first]) == key)) {
+                                _built.invalidate();
+                                return;
+                                }
+                            }
+                        _built.built(all, revision);
+                        };
+
+                    // Builds the column now ('find' builds it when needed)
+                    void build(const std::vector<T>& all, std::size_t revision, const qs_manager_stats& stats) const {
+                        stats.index_rebuild();
+                        _keys.resize(all.size());
+                        for (std::size_t i = 0; i < all.size(); ++i) {
+                            _keys[i] = qs_manager_key<T, ID>::of(all[i]);
+                            }
+                        _built.built(all, revision);
+                        };
+
+                private:
+                    typedef typename qs_manager_key<T, ID>::type key_type;
+                    typedef std::vector<key_type, qs_allocator<key_type> > column_type;
+
+                    bool _enabled;
+                    qs_manager_built_revision _built;
+                    mutable column_type _keys;
+                };
+
+            // Lookup result for a position returned by the index
+            template <class T>
+            qs_lookup<T> lookup_at(const std::vector<T>& all, std::size_t pos) {
+                if (pos == qs_manager_vector_index_base::not_found) {
+                    return qs_lookup<T>(qs_status::not_found);
+                    }
+                if (pos == qs_manager_vector_index_base::duplicated) {
+                    return qs_lookup<T>(qs_status::multiple_found);
+                    }
+                return qs_lookup<T>(qs_status::found, &all[pos]);
+                };
+
+            // Look for several ids in just one pass over a vector, every item is compared with every id.
+            template <class T, class ID, typename Enable = void>
+            struct qs_manager_vector_find_many {
+                template <class Range>
+                static void find(const std::vector<T>& all, const Range& ids, std::vector<qs_lookup<T> >& results, const qs_manager_stats& stats) {
+                    std::vector<ID> keys(std::begin(ids), std::end(ids));
+                    results.assign(keys.size(), qs_lookup<T>());
+                    stats.compared(all.size()*keys.size());
+                    for (typename std::vector<T>::const_iterator item = all.begin(); item != all.end(); ++item) {
+                        for (std::size_t i = 0; i < keys.size(); ++i) {
+                            if (::core::utils::qs_manager_implementation::operator==(*item, keys[i])) {
+                                add_match(results[i], *item);
+                                }
+                            }
+                        }
+                    };
+                };
+
+            // Look for several ids in just one pass over a vector, the key of every item is looked up among the ids.
+            template <class T, class ID>
+            struct qs_manager_vector_find_many<T, ID,
+                typename std::enable_if< is_key_of_available<T, ID>::value >::type
+                > {
+                template <class Range>
+                static void find(const std::vector<T>& all, const Range& ids, std::vector<qs_lookup<T> >& results, const qs_manager_stats& stats) {
+                    typedef typename qs_manager_key<T, ID>::type key_type;
+                    static const std::size_t no_slot = std::size_t(-1);
+
+                    std::unordered_map<key_type, std::size_t> slots; // same id may be requested several times
+                    std::vector<std::size_t> slot_of;
+                    for (typename Range::const_iterator it = std::begin(ids); it != std::end(ids); ++it) {
+                        key_type key;
+                        slot_of.push_back(qs_manager_key<T, ID>::from_id(*it, key) ? slots.insert(std::make_pair(key, slots.size())).first->second : no_slot);
+                        }
+                    std::vector<qs_lookup<T> > found(slots.size());
+                    stats.compared(all.size());
+                    for (typename std::vector<T>::const_iterator item = all.begin(); item != all.end(); ++item) {
+                        typename std::unordered_map<key_type, std::size_t>::const_iterator it = slots.find(qs_manager_key<T, ID>::of(*item));
+                        if (it != slots.end()) {
+                            add_match(found[it->second], *item);
+                            }
+                        }
+                    results.resize(slot_of.size());
+                    for (std::size_t i = 0; i < slot_of.size(); ++i) {
+                        results[i] = (slot_of[i] == no_slot) ? qs_lookup<T>() : found[slot_of[i]];
+                        }
+                    };
+                };
+
+            // Look for an id iterating all elements (check if there are many), using 'operator==(const T&, const ID&)'
+            template <class T, class ID, typename Enable = void>
+            struct qs_manager_vector_scan {
+                static qs_lookup<T> find(const std::vector<T>& all, const ID& id, const qs_manager_stats& stats) {
+                    qs_lookup<T> found;
+                    typename std::vector<T>::const_iterator begin = all.begin(), end = all.end();
+                    while (begin != end) {
+                        if ( ::core::utils::qs_manager_implementation::operator==(*begin,id)) {
+                            if (found) {
+                                stats.compared(std::distance(all.begin(), begin) + 1);
+                                return qs_lookup<T>(qs_status::multiple_found);
+                                }
+                            found = qs_lookup<T>(qs_status::found, &(*begin));
+                            }
+                        ++begin;
+                        }
+                    stats.compared(all.size());
+                    return found;
+                    };
+                };
+
+            // Look for an id iterating all elements comparing their keys, the id is converted just once
+            template <class T, class ID>
+            struct qs_manager_vector_scan<T, ID,
+                typename std::enable_if< is_key_of_available<T, ID>::value >::type
+                > {
+                static qs_lookup<T> find(const std::vector<T>& all, const ID& id, const qs_manager_stats& stats) {
+                    typename qs_manager_key<T, ID>::type key;
+                    if (!qs_manager_key<T, ID>::from_id(id, key)) {
+                        return qs_lookup<T>();
+                        }
+                    qs_lookup<T> found;
+                    typename std::vector<T>::const_iterator begin = all.begin(), end = all.end();
+                    while (begin != end) {
+                        if (qs_manager_key<T, ID>::of(*begin) == key) {
+                            if (found) {
+                                stats.compared(std::distance(all.begin(), begin) + 1);
+                                return qs_lookup<T>(qs_status::multiple_found);
+                                }
+                            found = qs_lookup<T>(qs_status::found, &(*begin));
+                            }
+                        ++begin;
+                        }
+                    stats.compared(all.size());
+                    return found;
+                    };
+                };
+
+            // Lookups on a vector, through the index if it is enabled (used by managers and snapshots)
+            template <class T, class ID>
+            struct qs_manager_vector_lookup {
+                static qs_lookup<T> try_get(const std::vector<T>& all, const ID& id, const qs_manager_vector_index<T, ID>& index, const qs_manager_vector_column<T, ID>& column, std::size_t revision, const qs_manager_stats& stats) {
+                    stats.lookup();
+                    if (index.enabled()) {
+                        return lookup_at(all, index.find(all, id, revision, stats));
+                        }
+                    if (column.enabled()) {
+                        return lookup_at(all, column.find(all, id, revision, stats));
+                        }
+                    // We have to iterate all elements to look for one (check if there are many)
+                    return qs_manager_vector_scan<T, ID>::find(all, id, stats);
+                    };
+
+                template <class Range>
+                static std::vector<qs_lookup<T> > get_many(const std::vector<T>& all, const Range& ids, const qs_manager_vector_index<T, ID>& index, std::size_t revision, const qs_manager_stats& stats) {
+                    std::vector<qs_lookup<T> > results;
+                    if (index.enabled()) {
+                        for (typename Range::const_iterator it = std::begin(ids); it != std::end(ids); ++it) {
+                            results.push_back(lookup_at(all, index.find(all, *it, revision, stats)));
+                            }
+                        }
+                    else {
+                        qs_manager_vector_find_many<T, ID>::find(all, ids, results, stats);
+                        }
+                    stats.lookup(results.size());
+                    return results;
+                    };
+                };
+
+            // Immutable copy of the data of a vector based manager (see 'qs_snapshot'), the index is built beforehand
+            //  so lookups only read from it.
+            template <class T, class ID>
+            class qs_manager_vector_store {
+                public:
+                    typedef qs_view<typename std::vector<T>::const_iterator> view_type;
+
+                    qs_manager_vector_store(std::vector<T>& data, std::size_t revision, bool indexed, bool columned) : _revision(revision), _index(indexed), _column(columned) {
+                        _data.swap(data);
+                        if (_index.enabled()) {
+                            _index.build(_data, frozen, _stats);
+                            }
+                        if (_column.enabled()) {
+                            _column.build(_data, frozen, _stats);
+                            }
+                        };
+
+                    view_type view() const {
+                        return view_type(_data.begin(), _data.end(), _data.size());
+                        };
+                    std::size_t size() const {
+                        return _data.size();
+                        };
+                    std::size_t revision() const {
+                        return _revision;
+                        };
+                    const qs_manager_stats& stats() const {
+                        return _stats;
+                        };
+
+                    qs_lookup<T> try_get(const ID& id) const {
+                        qs_manager_stats::timer timer(_stats);
+                        return qs_manager_vector_lookup<T, ID>::try_get(_data, id, _index, _column, frozen, _stats);
+                        };
+                    template <class Range>
+                    std::vector<qs_lookup<T> > get_many(const Range& ids) const {
+                        qs_manager_stats::timer timer(_stats);
+                        return qs_manager_vector_lookup<T, ID>::get_many(_data, ids, _index, frozen, _stats);
+                        };
+
+                private:
+                    // Revision of '_data' for the index and the column (it never changes, whatever the revision of the container is)
+                    static const std::size_t frozen = 1;
+
+                    std::vector<T> _data;
+                    std::size_t _revision;
+                    qs_manager_vector_index<T, ID> _index;
+                    qs_manager_vector_column<T, ID> _column;
+                    qs_manager_stats _stats;
+                };
+
+            template <class Derived, class T, class ID>
+            class qs_manager_getter_vector<Derived, T, ID,
+                typename std::enable_if< is_operator_available<T, ID>::value || is_key_of_available<T, ID>::value >::type
+                > {
+                public:
+                    typedef qs_view<typename std::vector<T>::const_iterator> view_type;
+                    typedef qs_manager_vector_store<T, ID> snapshot_store;
+                    typedef std::true_type vector_getter;
+
+                    std::size_t count() const {
+                        return this->__derived().all().size();
+                        };
+                    const T& get(const ID& id) const {
+                        return object_or_throw(this->try_get(id), id, _stats);
+                        };
+
+                    // Same as 'get' but it doesn't throw, the status tells if the object was found
+                    qs_lookup<T> try_get(const ID& id) const {
+                        qs_manager_stats::timer timer(_stats);
+                        const std::vector<T>& all = this->__derived().all();
+                        return qs_manager_vector_lookup<T, ID>::try_get(all, id, _index, _column, this->__derived().__revision(), _stats);
+                        };
+
+                    // Look for several objects at once, results are in the same order as 'ids'
+                    template <class Range>
+                    std::vector<qs_lookup<T> > get_many(const Range& ids) const {
+                        qs_manager_stats::timer timer(_stats);
+                        const std::vector<T>& all = this->__derived().all();
+                        return qs_manager_vector_lookup<T, ID>::get_many(all, ids, _index, this->__derived().__revision(), _stats);
+                        };
+                    std::vector<qs_lookup<T> > get_many(std::initializer_list<ID> ids) const {
+                        return this->get_many<std::initializer_list<ID> >(ids);
+                        };
+
+                    // Look for objects using a hashed index over 'key_of' instead of iterating all of them. It is rebuilt when the
+                    //  data changes: if the container has no 'generation()' and doesn't notify its changes, only when the vector
+                    //  moves or its size changes (call 'reindex()' after other changes).
+                    void use_index(bool enable = true) {
+                        _index.enable(enable);
+                        };
+                    // Look for objects scanning a column with their keys (SIMD if available), only for integral keys. It is cheaper
+                    //  than the index to keep, but 'get_many' still iterates the objects. It is rebuilt like the index.
+                    void use_column(bool enable = true) {
+                        _column.enable(enable);
+                        };
+                    // Force the index (and the key column) to be rebuilt (needed only if items were modified in place)
+                    void reindex() const {
+                        _index.invalidate();
+                        _column.invalidate();
+                        };
+
+                    // Copy of the data sorted by 'key_of' (see 'qs_sorted_vector')
+                    template <class Key = typename key_of_type<T>::type>
+                    qs_sorted_vector<Key, T> freeze() const {
+                        const std::vector<T>& all = this->__derived().all();
+                        std::vector<std::pair<Key, T> > data;
+                        data.reserve(all.size());
+                        for (typename std::vector<T>::const_iterator it = all.begin(); it != all.end(); ++it) {
+                            data.push_back(std::make_pair(qs_manager_key<T, ID>::of(*it), *it));
+                            }
+                        _stats.copied(data.size()*sizeof(std::pair<Key, T>));
+                        return qs_sorted_vector<Key, T>(std::move(data));
+                        };
+
+                    // Counters for this manager (see QS_MANAGER_STATS)
+                    const qs_manager_stats& stats() const {
+                        return _stats;
+                        };
+
+                protected:
+                    const Derived& __derived() const {
+                        return static_cast<const Derived&>(*this);
+                        };
+
+                    // Revision of the data returned by 'all', '0' if unknown
+                    std::size_t __revision() const {
+                        return 0;
+                        };
+                    // Takes the data '__view' returns if it has to be copied (see 'qs_manager::begin')
+                    void __load() const {};
+                    // Lets the next changes notified by the container be located (see 'qs_change_place'), called when the
+                    //  table of the secondary indexes is taken again
+                    void __locate_changes() const {};
+
+                    // New immutable copy of the data (see 'qs_manager::snapshot'), 'revision' is the revision of the data (see 'qs_snapshot::revision')
+                    std::shared_ptr<const snapshot_store> __make_snapshot(std::size_t revision) const {
+                        std::vector<T> data;
+                        this->__derived().all(data);
+                        _stats.snapshot_rebuild(data.size()*sizeof(T));
+                        return std::make_shared<const snapshot_store>(data, revision, _index.enabled(), _column.enabled());
+                        };
+
+                    // Object a change notified by the container refers to (see 'qs_observer'), 'all' is the data before the change
+                    qs_lookup<T> __find_change(const std::vector<T>& all, const ID& id, std::size_t previous) const {
+                        return qs_manager_vector_lookup<T, ID>::try_get(all, id, _index, _column, previous, _stats);
+                        };
+                    // Keeps the index and the key column up to date with a change notified by the container (see 'qs_observer'),
+                    //  'all' is the data already changed and 'previous' its revision before the change
+                    void __apply_change(qs_change change, const ID& id, const std::vector<T>& all, std::size_t previous, std::size_t revision) const {
+                        _index.apply(change, id, all, previous, revision);
+                        _column.apply(change, id, all, previous, revision);
+                        };
+                    // Position of the object a change refers to in the data of revision 'previous', if the index knows it
+                    std::size_t __position_of_change(const ID& id, std::size_t previous) const {
+                        return _index.position(id, previous);
+                        };
+
+                    // Memory for the index and the key column (see 'qs_manager' constructor)
+                    void __memory_resource(qs_memory_resource* resource) {
+                        _index.resource(resource);
+                        _column.resource(resource);
+                        };
+
+                    qs_manager_vector_index<T, ID> _index;
+                    qs_manager_vector_column<T, ID> _column;
+                    qs_manager_stats _stats;
+                };
+            
+
+            // - all to vector
+            template <class T, class ID, class ClassToTest>
+            class qs_manager_get_impl<T, ID, ClassToTest,
+                    typename std::enable_if<has_all_to_container<ClassToTest, std::vector<T> >::value>::type
+                    > : public qs_manager_getter_vector<qs_manager_get_impl<T, ID, ClassToTest, typename std::enable_if<has_all_to_container<ClassToTest, std::vector<T> >::value>::type>, T, ID>
+                {
+                    friend class qs_manager_getter_vector<qs_manager_get_impl, T, ID>;
+                public:
+                    explicit qs_manager_get_impl(const ClassToTest& container) : _container(container) {                        
+                        };
+
+                    void all(std::vector<T>& ret) const {
+                        _container.all(ret);
+                        this->_stats.copied(ret.size()*sizeof(T));
+                        };
+
+                    const std::vector<T>& all() const {
+                        return __all.update(_container, this->_stats); // We have to update this vector each time because it may have been updated (unless its generation is the same).
+                        };
+
+                    typename qs_manager_getter_vector<qs_manager_get_impl, T, ID>::view_type view() const {
+                        __all.update(_container, this->_stats);
+                        return this->__view();
+                        };
+
+                    //const T& __get(const ID& id) const {};
+                protected:
+                    typename qs_manager_getter_vector<qs_manager_get_impl, T, ID>::view_type __view() const {
+                        const std::vector<T>& all = __all.data();
+                        return typename qs_manager_getter_vector<qs_manager_get_impl, T, ID>::view_type(all.begin(), all.end(), all.size());
+                        };
+                    void __load() const {
+                        __all.load(_container, this->_stats);
+                        };
+
+                    std::size_t __revision() const {
+                        return __all.revision();
+                        };
+
+                    // Changes notified by the container (see 'qs_observer'), the object is looked for in the copy before the change
+                    void __observe() {
+                        __all.observe();
+                        };
+                    qs_change_place<T> __on_change(qs_change change, const ID& id, const T* item) const {
+                        std::size_t previous = __all.revision();
+                        if (previous == 0) {
+                            return qs_change_place<T>(); // nothing copied yet
+                            }
+                        std::vector<T>& data = __all.changes();
+                        std::size_t position = data.size();
+                        if (change == qs_change::insert) {
+                            data.push_back(*item);
+                            }
+                        else {
+                            qs_lookup<T> found = this->__find_change(data, id, previous);
+                            if (found.status != qs_status::found) {
+                                __all.invalidate();
+                                return qs_change_place<T>();
+                                }
+                            position = found.object - data.data();
+                            if (change == qs_change::erase) {
+                                data.erase(data.begin() + position);
+                                }
+                            else {
+                                data[position] = *item;
+                                }
+                            }
+                        if (item) {
+                            this->_stats.copied(sizeof(T));
+                            }
+                        this->__apply_change(change, id, data, previous, __all.sync(_container));
+                        return qs_change_place<T>::at(position);
+                        };
+
+                    const ClassToTest& _container;
+                private:
+                    qs_manager_snapshot<ClassToTest, std::vector<T> > __all;
+                };
+
+            // - all returns vector.
+            template <class T, class ID, class ClassToTest>
+            class qs_manager_get_impl<T, ID, ClassToTest,
+                    typename std::enable_if<has_all_as_container<ClassToTest, std::vector<T> >::value>::type
+                    > : public qs_manager_getter_vector<qs_manager_get_impl<T, ID, ClassToTest, typename std::enable_if<has_all_as_container<ClassToTest, std::vector<T> >::value>::type>, T, ID>
+                {
+                    friend class qs_manager_getter_vector<qs_manager_get_impl, T, ID>;
+                public:
+                    explicit qs_manager_get_impl(const ClassToTest& container) : _container(container) {                        
+                        };
+
+                    void all(std::vector<T>& ret) const {
+                        ret = _container.all();
+                        };
+
+                    const std::vector<T>& all() const {
+                        __generation.update(_container);
+                        return _container.all();
+                        };
+
+                    typename qs_manager_getter_vector<qs_manager_get_impl, T, ID>::view_type view() const {
+                        const std::vector<T>& all = _container.all();
+                        return typename qs_manager_getter_vector<qs_manager_get_impl, T, ID>::view_type(all.begin(), all.end(), all.size());
+                        };
+
+                protected:
+                    typename qs_manager_getter_vector<qs_manager_get_impl, T, ID>::view_type __view() const {
+                        return this->view();
+                        };
+
+                    // The vector is read in place: if the container cannot tell when it changes, the revision is unknown
+                    std::size_t __revision() const {
+                        return __generation.known() ? __generation.revision() : 0;
+                        };
+
+                    // Changes notified by the container (see 'qs_observer'), they are already in its data: erased and updated
+                    //  objects are located with the index (if it is enabled), so it is kept built
+                    void __observe() {
+                        __generation.observe();
+                        };
+                    void __locate_changes() const {
+                        __generation.update(_container);
+                        this->_index.update(_container.all(), this->__revision(), this->_stats);
+                        };
+                    qs_change_place<T> __on_change(qs_change change, const ID& id, const T*) const {
+                        std::size_t previous = __generation.revision();
+                        const std::vector<T>& all = _container.all();
+                        // Inserted objects go to the end, the rest are located with the index (if it is enabled)
+                        std::size_t position = (change == qs_change::insert) ? all.size() - 1 : this->__position_of_change(id, previous);
+                        this->__apply_change(change, id, all, previous, __generation.sync(_container));
+                        return (position < all.size() + (change == qs_change::erase ? 1 : 0)) ? qs_change_place<T>::at(position) : qs_change_place<T>();
+                        };
+
+                    const ClassToTest& _container;
+                private:
+                    qs_manager_generation<ClassToTest> __generation;
+                };
+
+            // - container IS a vector
+            template <class T, class ID>
+            class qs_manager_get_impl<T, ID, std::vector<T>, void> : public qs_manager_getter_vector<qs_manager_get_impl<T, ID, std::vector<T>, void>, T, ID> {
+                public:
+                    explicit qs_manager_get_impl(const std::vector<T>& container) : _container(container) {
+                        };
+
+                    void all(std::vector<T>& ret) const {
+                        ret = _container;
+                        };
+
+                    const std::vector<T>& all() const {
+                        return _container;
+                        };
+
+                    typename qs_manager_getter_vector<qs_manager_get_impl, T, ID>::view_type view() const {
+                        return typename qs_manager_getter_vector<qs_manager_get_impl, T, ID>::view_type(_container.begin(), _container.end(), _container.size());
+                        };
+
+                protected:
+                    typename qs_manager_getter_vector<qs_manager_get_impl, T, ID>::view_type __view() const {
+                        return this->view();
+                        };
+
+                    const std::vector<T>& _container;
+                };
+
+/**********************
+    MAPS
+***********************/
+            // Iterator over the values of a map (it yields what 'second_t' below returns, without the copy)
+            template <class MapIterator>
+            class second_iterator {
+                public:
+                    typedef typename std::iterator_traits<MapIterator>::iterator_category iterator_category;
+                    typedef typename std::iterator_traits<MapIterator>::value_type::second_type value_type;
+                    typedef typename std::iterator_traits<MapIterator>::difference_type difference_type;
+                    typedef const value_type* pointer;
+                    typedef const value_type& reference;
+
+                    second_iterator() {};
+                    explicit second_iterator(MapIterator it) : _it(it) {};
+
+                    reference operator*() const { return _it->second; };
+                    pointer operator->() const { return &(_it->second); };
+                    second_iterator& operator++() { ++_it; return *this; };
+                    second_iterator operator++(int) { second_iterator tmp(*this); ++_it; return tmp; };
+                    second_iterator& operator--() { --_it; return *this; };
+                    second_iterator operator--(int) { second_iterator tmp(*this); --_it; return tmp; };
+                    bool operator==(const second_iterator& other) const { return _it == other._it; };
+                    bool operator!=(const second_iterator& other) const { return _it != other._it; };
+                    // Only for random access maps (sorted vectors,...), used to split them among threads
+                    second_iterator operator+(difference_type n) const { return second_iterator(_it + n); };
+                    difference_type operator-(const second_iterator& other) const { return _it - other._it; };
+                    reference operator[](difference_type n) const { return _it[n].second; };
+
+                    MapIterator base() const { return _it; };
+                private:
+                    MapIterator _it;
+                };
+
+            // Map types qs_manager works with: std::map, std::multimap, std::unordered_map and std::unordered_multimap
+            template <class TMap, class T, class ID>
+            struct is_map_container : std::false_type {};
+            template <class T, class ID, class Compare, class Alloc>
+            struct is_map_container<std::map<ID, T, Compare, Alloc>, T, ID> : std::true_type {};
+            template <class T, class ID, class Compare, class Alloc>
+            struct is_map_container<std::multimap<ID, T, Compare, Alloc>, T, ID> : std::true_type {};
+            template <class T, class ID, class Hash, class Pred, class Alloc>
+            struct is_map_container<std::unordered_map<ID, T, Hash, Pred, Alloc>, T, ID> : std::true_type {};
+            template <class T, class ID, class Hash, class Pred, class Alloc>
+            struct is_map_container<std::unordered_multimap<ID, T, Hash, Pred, Alloc>, T, ID> : std::true_type {};
+            template <class T, class ID, class Key, class Compare>
+            struct is_map_container<qs_sorted_vector<Key, T, Compare>, T, ID> : std::integral_constant<bool, qs_manager_id_to_key<ID, Key>::value> {};
+
+            template <class TMap>
+            struct is_sorted_vector : std::false_type {};
+            template <class Key, class T, class Compare>
+            struct is_sorted_vector<qs_sorted_vector<Key, T, Compare> > : std::true_type {};
+
+            // The map type a container implements 'all' for ('void' if none)
+            template <class T, class ID, class ClassToTest, template <typename, typename> class HasAll>
+            struct map_type_of {
+                typedef typename std::conditional<HasAll<ClassToTest, std::map<ID, T> >::value, std::map<ID, T>,
+                        typename std::conditional<HasAll<ClassToTest, std::multimap<ID, T> >::value, std::multimap<ID, T>,
+                        typename std::conditional<HasAll<ClassToTest, std::unordered_map<ID, T> >::value, std::unordered_map<ID, T>,
+                        typename std::conditional<HasAll<ClassToTest, std::unordered_multimap<ID, T> >::value, std::unordered_multimap<ID, T>,
+                        typename std::conditional<HasAll<ClassToTest, qs_sorted_vector<ID, T> >::value, qs_sorted_vector<ID, T>,
+                        void>::type>::type>::type>::type>::type type;
+                enum { value = !std::is_void<type>::value };
+                };
+
+            template <class T, class ID, class ClassToTest>
+            struct all_to_map : map_type_of<T, ID, ClassToTest, has_all_to_container> {};
+
+            template <class T, class ID, class ClassToTest>
+            struct all_as_map : map_type_of<T, ID, ClassToTest, has_all_as_container> {};
+
+            // Look for an id in a map (there cannot be duplicates on maps, see MULTIMAPS for the others)
+            template <class TMap, typename Enable = void>
+            struct qs_manager_map_find {
+                template <class ID>
+                static qs_status find(const TMap& all, const ID& id, typename TMap::const_iterator& it) {
+                    it = all.find(id);
+                    return (it == all.end()) ? qs_status::not_found : qs_status::found;
+                    };
+                };
+
+            template <class TMap>
+            struct is_ordered_map : std::false_type {};
+            template <class ID, class T, class Compare, class Alloc>
+            struct is_ordered_map<std::map<ID, T, Compare, Alloc> > : std::true_type {};
+            template <class ID, class T, class Compare, class Alloc>
+            struct is_ordered_map<std::multimap<ID, T, Compare, Alloc> > : std::true_type {};
+
+            template <class TMap>
+            struct is_multimap : std::false_type {};
+            template <class ID, class T, class Compare, class Alloc>
+            struct is_multimap<std::multimap<ID, T, Compare, Alloc> > : std::true_type {};
+            template <class ID, class T, class Hash, class Pred, class Alloc>
+            struct is_multimap<std::unordered_multimap<ID, T, Hash, Pred, Alloc> > : std::true_type {};
+
+            // Look for several ids in a map, one lookup each.
+            template <class TMap>
+            struct qs_manager_map_find_each {
+                template <class T, class Range>
+                static void find(const TMap& all, const Range& ids, std::vector<qs_lookup<T> >& results) {
+                    typename TMap::const_iterator found;
+                    for (typename Range::const_iterator it = std::begin(ids); it != std::end(ids); ++it) {
+                        qs_status status = qs_manager_map_find<TMap>::find(all, *it, found);
+                        results.push_back(qs_lookup<T>(status, (status == qs_status::found) ? &found->second : nullptr));
+                        }
+                    };
+                };
+
+            // Look for an id in a sorted vector, duplicates are next to each other
+            template <class TMap>
+            struct qs_manager_map_find<TMap,
+                typename std::enable_if< is_sorted_vector<TMap>::value >::type
+                > {
+                template <class ID>
+                static qs_status find(const TMap& all, const ID& id, typename TMap::const_iterator& it) {
+                    typename TMap::key_type key;
+                    if (!qs_manager_id_to_key<ID, typename TMap::key_type>::convert(id, key)) {
+                        it = all.end();
+                        return qs_status::not_found;
+                        }
+                    it = all.lower_bound(key);
+                    typename TMap::key_compare comp = all.key_comp();
+                    if (it == all.end() || comp(key, it->first)) {
+                        return qs_status::not_found;
+                        }
+                    typename TMap::const_iterator next = std::next(it);
+                    return (next != all.end() && !comp(key, next->first)) ? qs_status::multiple_found : qs_status::found;
+                    };
+                };
+
+            template <class TMap, typename Enable = void>
+            struct qs_manager_map_find_many : qs_manager_map_find_each<TMap> {};
+
+            // Look for several keys in a sorted container: if there are many keys (compared to the size of the container) they
+            //  are sorted and the container is walked alongside them, O(n + K log K) instead of O(K log n).
+            template <class TMap>
+            struct qs_manager_sorted_find_many {
+                template <class T>
+                static void find(const TMap& all, const std::vector<typename TMap::key_type>& keys, std::vector<qs_lookup<T> >& results) {
+                    std::size_t depth = 1;
+                    while ((std::size_t(1) << depth) < all.size()) {
+                        ++depth;
+                        }
+                    if (keys.size()*depth < all.size()) {
+                        qs_manager_map_find_each<TMap>::find(all, keys, results);
+                        return;
+                        }
+
+                    typename TMap::key_compare comp = all.key_comp();
+                    std::vector<std::size_t> order(keys.size());
+                    for (std::size_t i = 0; i < order.size(); ++i) {
+                        order[i] = i;
+                        }
+                    std::sort(order.begin(), order.end(), [&keys, &comp](std::size_t lhs, std::size_t rhs) { return comp(keys[lhs], keys[rhs]); });
+
+                    std::size_t prev = results.size();
+                    results.resize(prev + keys.size());
+                    typename TMap::const_iterator it = all.begin();
+                    for (std::size_t i = 0; i < order.size(); ++i) {
+                        const typename TMap::key_type& key = keys[order[i]];
+                        while (it != all.end() && comp(it->first, key)) {
+                            ++it;
+                            }
+                        if (it == all.end() || comp(key, it->first)) {
+                            continue; // not found
+                            }
+                        typename TMap::const_iterator next = std::next(it);
+                        results[prev + order[i]] = (next != all.end() && !comp(key, next->first)) ? qs_lookup<T>(qs_status::multiple_found) : qs_lookup<T>(qs_status::found, &it->second);
+                        }
+                    };
+                };
+
+            template <class TMap>
+            struct qs_manager_map_find_many<TMap,
+                typename std::enable_if< is_ordered_map<TMap>::value >::type
+                > {
+                template <class T, class Range>
+                static void find(const TMap& all, const Range& ids, std::vector<qs_lookup<T> >& results) {
+                    std::vector<typename TMap::key_type> keys(std::begin(ids), std::end(ids));
+                    qs_manager_sorted_find_many<TMap>::find(all, keys, results);
+                    };
+                };
+
+            // Sorted vectors may have keys of other type than ids, the ids that cannot be converted are not found.
+            template <class TMap>
+            struct qs_manager_map_find_many<TMap,
+                typename std::enable_if< is_sorted_vector<TMap>::value >::type
+                > {
+                template <class T, class Range>
+                static void find(const TMap& all, const Range& ids, std::vector<qs_lookup<T> >& results) {
+                    typedef typename std::decay<decltype(*std::begin(ids))>::type id_type;
+                    std::vector<typename TMap::key_type> keys;
+                    std::vector<std::size_t> positions;
+                    std::size_t count = 0;
+                    for (typename Range::const_iterator it = std::begin(ids); it != std::end(ids); ++it, ++count) {
+                        typename TMap::key_type key;
+                        if (qs_manager_id_to_key<id_type, typename TMap::key_type>::convert(*it, key)) {
+                            keys.push_back(key);
+                            positions.push_back(count);
+                            }
+                        }
+                    std::vector<qs_lookup<T> > found;
+                    qs_manager_sorted_find_many<TMap>::find(all, keys, found);
+                    std::size_t prev = results.size();
+                    results.resize(prev + count);
+                    for (std::size_t i = 0; i < positions.size(); ++i) {
+                        results[prev + positions[i]] = found[i];
+                        }
+                    };
+                };
+
+            // Immutable copy of the data of a map based manager (see 'qs_snapshot')
+            template <class T, class ID, class TMap>
+            class qs_manager_map_store {
+                public:
+                    typedef qs_view<second_iterator<typename TMap::const_iterator> > view_type;
+
+                    qs_manager_map_store(TMap& data, std::size_t revision) : _revision(revision) {
+                        _data.swap(data);
+                        };
+
+                    view_type view() const {
+                        typedef typename view_type::const_iterator iterator;
+                        return view_type(iterator(_data.begin()), iterator(_data.end()), _data.size());
+                        };
+                    std::size_t size() const {
+                        return _data.size();
+                        };
+                    std::size_t revision() const {
+                        return _revision;
+                        };
+                    const qs_manager_stats& stats() const {
+                        return _stats;
+                        };
+
+                    qs_lookup<T> try_get(const ID& id) const {
+                        qs_manager_stats::timer timer(_stats);
+                        _stats.lookup();
+                        typename TMap::const_iterator it;
+                        qs_status status = qs_manager_map_find<TMap>::find(_data, id, it);
+                        return qs_lookup<T>(status, (status == qs_status::found) ? &it->second : nullptr);
+                        };
+                    template <class Range>
+                    std::vector<qs_lookup<T> > get_many(const Range& ids) const {
+                        qs_manager_stats::timer timer(_stats);
+                        std::vector<qs_lookup<T> > results;
+                        qs_manager_map_find_many<TMap>::find(_data, ids, results);
+                        _stats.lookup(results.size());
+                        return results;
+                        };
+
+                private:
+                    TMap _data;
+                    std::size_t _revision;
+                    qs_manager_stats _stats;
+                };
+
+            // Map implementations: the adapter ('Derived') provides '__get_all()' and 'count()' (see 'qs_manager_getter_vector')
+            template <class Derived, class T, class ID, class TMap = std::map<ID, T> >
+            class qs_manager_getter_map {
+                public:
+                    typedef qs_view<second_iterator<typename TMap::const_iterator> > view_type;
+                    typedef qs_manager_map_store<T, ID, TMap> snapshot_store;
+                    typedef std::false_type vector_getter;
+
+                    view_type view() const {
+                        return this->__make_view(this->__derived().__get_all());
+                        };
+
+                    const T& get(const ID& id) const {
+                        return object_or_throw(this->try_get(id), id, _stats);
+                        };
+
+                    // Same as 'get' but it doesn't throw, the status tells if the object was found
+                    qs_lookup<T> try_get(const ID& id) const {
+                        qs_manager_stats::timer timer(_stats);
+                        _stats.lookup();
+                        typename TMap::const_iterator it;
+                        qs_status status = qs_manager_map_find<TMap>::find(this->__derived().__get_all(), id, it);
+                        return qs_lookup<T>(status, (status == qs_status::found) ? &it->second : nullptr);
+                        };
+
+                    // Look for several objects at once, results are in the same order as 'ids'
+                    template <class Range>
+                    std::vector<qs_lookup<T> > get_many(const Range& ids) const {
+                        qs_manager_stats::timer timer(_stats);
+                        std::vector<qs_lookup<T> > results;
+                        qs_manager_map_find_many<TMap>::find(this->__derived().__get_all(), ids, results);
+                        _stats.lookup(results.size());
+                        return results;
+                        };
+                    std::vector<qs_lookup<T> > get_many(std::initializer_list<ID> ids) const {
+                        return this->get_many<std::initializer_list<ID> >(ids);
+                        };
+
+                    // Copy of the data sorted by id (see 'qs_sorted_vector')
+                    qs_sorted_vector<typename TMap::key_type, T> freeze() const {
+                        const TMap& all = this->__derived().__get_all();
+                        _stats.copied(all.size()*sizeof(typename qs_sorted_vector<typename TMap::key_type, T>::value_type));
+                        return qs_sorted_vector<typename TMap::key_type, T>(all.begin(), all.end());
+                        };
+                protected:
+                    const Derived& __derived() const {
+                        return static_cast<const Derived&>(*this);
+                        };
+
+                    // Copies the map, it must not touch the data cached by the manager (see 'qs_manager::snapshot')
+                    void __copy_all(TMap& ret) const {
+                        ret = this->__derived().__get_all();
+                        };
+
+                    // New immutable copy of the data (see 'qs_manager::snapshot'), 'revision' is the revision of the data (see 'qs_snapshot::revision')
+                    std::shared_ptr<const snapshot_store> __make_snapshot(std::size_t revision) const {
+                        TMap data;
+                        this->__derived().__copy_all(data);
+                        _stats.snapshot_rebuild(data.size()*sizeof(typename TMap::value_type));
+                        return std::make_shared<const snapshot_store>(data, revision);
+                        };
+
+                    // Same as 'view' but it doesn't update the data
+                    view_type __view() const {
+                        return this->view();
+                        };
+                    // Takes the data '__view' returns if it has to be copied (see 'qs_manager::begin')
+                    void __load() const {};
+                    void __locate_changes() const {};
+
+                    static view_type __make_view(const TMap& all) {
+                        typedef typename view_type::const_iterator iterator;
+                        return view_type(iterator(all.begin()), iterator(all.end()), all.size());
+                        };
+
+                public:
+                    // Counters for this manager (see QS_MANAGER_STATS)
+                    const qs_manager_stats& stats() const {
+                        return _stats;
+                        };
+
+                protected:
+                    qs_manager_stats _stats;
+                };
+
+            // Credit: http://stackoverflow.com/questions/771453/copy-map-values-to-vector-in-stl
+            template <typename tPair>
+            struct second_t {
+                const typename tPair::second_type& operator()(const tPair& p) const { return p.second;}; // copied once, into the vector
+                };
+            template <typename tMap>
+            second_t<typename tMap::value_type> second(const tMap&) { return second_t<typename tMap::value_type>();};
+                    
+            // Applies a change notified by the container (see 'qs_observer') to a copy of its map, false if the copy doesn't
+            //  match the change (duplicated ids in a multimap,...) and it has to be taken again.
+            template <class TMap>
+            struct qs_manager_map_change {
+                template <class ID, class T>
+                static bool apply(TMap& data, qs_change change, const ID& id, const T* item) {
+                    std::size_t count = data.count(id);
+                    if (count != ((change == qs_change::insert) ? 0 : 1)) {
+                        return false;
+                        }
+                    if (change != qs_change::insert) {
+                        data.erase(id);
+                        }
+                    if (change != qs_change::erase) {
+                        data.insert(typename TMap::value_type(id, *item));
+                        }
+                    return true;
+                    };
+                };
+
+            // Where a change notified by the container happened in a map (see 'qs_change_place'): the object with the id,
+            //  unknown in multimaps (ids may be repeated) and sorted vectors (objects move)
+            template <class TMap, typename Enable = void>
+            struct qs_manager_map_place {
+                template <class T, class ID>
+                static qs_change_place<T> of(const TMap&, qs_change, const ID&) {
+                    return qs_change_place<T>();
+                    };
+                };
+            template <class TMap>
+            struct qs_manager_map_place<TMap,
+                typename std::enable_if< !is_multimap<TMap>::value && !is_sorted_vector<TMap>::value >::type
+                > {
+                template <class T, class ID>
+                static qs_change_place<T> of(const TMap& data, qs_change change, const ID& id) {
+                    typename TMap::const_iterator it = data.find(id);
+                    if ((it == data.end()) != (change == qs_change::erase)) {
+                        return qs_change_place<T>();
+                        }
+                    return qs_change_place<T>::of((it == data.end()) ? nullptr : &it->second);
+                    };
+                };
+
+            // - all to map
+            template <class T, class ID, class ClassToTest>
+            class qs_manager_get_impl<T, ID, ClassToTest,
+                    typename std::enable_if<all_to_map<T, ID, ClassToTest>::value>::type
+                    > : public qs_manager_getter_map<qs_manager_get_impl<T, ID, ClassToTest, typename std::enable_if<all_to_map<T, ID, ClassToTest>::value>::type>, T, ID, typename all_to_map<T, ID, ClassToTest>::type>
+                {
+                    friend class qs_manager_getter_map<qs_manager_get_impl, T, ID, typename all_to_map<T, ID, ClassToTest>::type>;
+                public:
+                    typedef typename all_to_map<T, ID, ClassToTest>::type map_type;
+
+                    explicit qs_manager_get_impl(const ClassToTest& container) : _container(container), __all_revision(0) {                        
+                        };
+
+                    std::size_t count() const {
+                        return this->__get_all().size();
+                        };
+
+                    void all(std::vector<T>& ret) const {
+                        const map_type& map = this->__get_all();
+                        std::transform( map.begin(), map.end(), std::back_inserter(ret), second(map));
+                        this->_stats.copied(map.size()*sizeof(T));
+                        };
+
+                    const std::vector<T>& all() const {
+                        const map_type& map = this->__get_all(); // We have to update this vector each time because it may have been updated (unless its generation is the same).
+                        if (__all_map.revision() == 0 || __all_revision != __all_map.revision()) {
+                            __all.clear();
+                            __all.reserve(map.size());
+                            std::transform( map.begin(), map.end(), std::back_inserter(__all), second(map));
+                            this->_stats.copied(__all.size()*sizeof(T));
+                            __all_revision = __all_map.revision();
+                            }
+                        return __all;
+                        };
+
+                private:
+                    const map_type& __get_all() const {
+                        return __all_map.update(_container, this->_stats);
+                        };
+
+                protected:
+                    typename qs_manager_getter_map<qs_manager_get_impl, T, ID, map_type>::view_type __view() const {
+                        return this->__make_view(__all_map.data());
+                        };
+                    void __load() const {
+                        __all_map.load(_container, this->_stats);
+                        };
+
+                    void __copy_all(map_type& ret) const {
+                        _container.all(ret);
+                        };
+
+                    // Changes notified by the container (see 'qs_observer') are applied to the copy of the map
+                    void __observe() {
+                        __all_map.observe();
+                        };
+                    qs_change_place<T> __on_change(qs_change change, const ID& id, const T* item) const {
+                        if (__all_map.revision() == 0) {
+                            return qs_change_place<T>(); // nothing copied yet
+                            }
+                        if (!qs_manager_map_change<map_type>::apply(__all_map.changes(), change, id, item)) {
+                            __all_map.invalidate();
+                            return qs_change_place<T>();
+                            }
+                        __all_map.sync(_container);
+                        return qs_manager_map_place<map_type>::template of<T>(__all_map.data(), change, id);
+                        };
+
+                protected:
+                    const ClassToTest& _container;
+                private:
+                    mutable std::vector<T> __all;
+                    mutable std::size_t __all_revision;
+                    qs_manager_snapshot<ClassToTest, map_type> __all_map;
+                };
+
+            // - all returns map.
+            template <class T, class ID, class ClassToTest>
+            class qs_manager_get_impl<T, ID, ClassToTest,
+                    typename std::enable_if<all_as_map<T, ID, ClassToTest>::value>::type
+                    > : public qs_manager_getter_map<qs_manager_get_impl<T, ID, ClassToTest, typename std::enable_if<all_as_map<T, ID, ClassToTest>::value>::type>, T, ID, typename all_as_map<T, ID, ClassToTest>::type>
+                {
+                    friend class qs_manager_getter_map<qs_manager_get_impl, T, ID, typename all_as_map<T, ID, ClassToTest>::type>;
+                public:
+                    typedef typename all_as_map<T, ID, ClassToTest>::type map_type;
+
+                    explicit qs_manager_get_impl(const ClassToTest& container) : _container(container) {                        
+                        };
+
+                    std::size_t count() const {
+                        return _container.all().size();
+                        };
+
+                    void all(std::vector<T>& ret) const {
+                        const map_type& all = _container.all();
+                        std::transform( all.begin(), all.end(), std::back_inserter(ret), second(all));
+                        this->_stats.copied(all.size()*sizeof(T));
+                        };
+
+                    const std::vector<T>& all() const {
+                        const map_type& all = _container.all();
+                        if (__generation.update(_container)) {
+                            __all.clear();
+                            __all.reserve(all.size());
+                            std::transform( all.begin(), all.end(), std::back_inserter(__all), second(all));
+                            this->_stats.copied(__all.size()*sizeof(T));
+                            }
+                        return __all;
+                        };
+
+                private:
+                    const map_type& __get_all() const {
+                        return _container.all();
+                        };
+
+                protected:
+                    // Changes notified by the container (see 'qs_observer'), only the vector returned by 'all' has to be taken again
+                    void __observe() {
+                        __generation.observe();
+                        };
+                    qs_change_place<T> __on_change(qs_change change, const ID& id, const T*) const {
+                        __generation.invalidate();
+                        return qs_manager_map_place<map_type>::template of<T>(_container.all(), change, id);
+                        };
+
+                    const ClassToTest& _container;
+                private:
+                    mutable std::vector<T> __all;
+                    qs_manager_generation<ClassToTest> __generation;
+                };
+
+            // - container IS a map
+            template <class T, class ID, class ClassToTest>
+            class qs_manager_get_impl<T, ID, ClassToTest,
+                    typename std::enable_if<is_map_container<ClassToTest, T, ID>::value>::type
+                    > : public qs_manager_getter_map<qs_manager_get_impl<T, ID, ClassToTest, typename std::enable_if<is_map_container<ClassToTest, T, ID>::value>::type>, T, ID, ClassToTest>
+                {
+                    friend class qs_manager_getter_map<qs_manager_get_impl, T, ID, ClassToTest>;
+                public:
+                    explicit qs_manager_get_impl(const ClassToTest& container) : _container(container) {
+                        };
+
+                    std::size_t count() const {
+                        return _container.size();
+                        };
+
+                    void all(std::vector<T>& ret) const {
+                        std::transform( _container.begin(), _container.end(), std::back_inserter(ret), second(_container));
+                        this->_stats.copied(_container.size()*sizeof(T));
+                        };
+
+                    const std::vector<T>& all() const {
+                        __all.clear();
+                        __all.reserve(_container.size());
+                        std::transform( _container.begin(), _container.end(), std::back_inserter(__all), second(_container));
+                        this->_stats.copied(__all.size()*sizeof(T));
+                        return __all;
+                        };
+
+                private:
+                    const ClassToTest& __get_all() const {
+                        return _container;
+                        };
+
+                protected:
+                    const ClassToTest& _container;
+                private:
+                    mutable std::vector<T> __all;
+                };
+
+/**********************
+    MULTIMAPS
+***********************/
+            // Look for an id in a multimap, same behaviour as vectors: it has to be there only once
+            template <class TMap>
+            struct qs_manager_map_find<TMap,
+                typename std::enable_if< is_multimap<TMap>::value >::type
+                > {
+                template <class ID>
+                static qs_status find(const TMap& all, const ID& id, typename TMap::const_iterator& it) {
+                    std::pair<typename TMap::const_iterator, typename TMap::const_iterator> range = all.equal_range(id);
+                    it = range.first;
+                    if (range.first == range.second) {
+                        return qs_status::not_found;
+                        }
+                    return (std::next(range.first) != range.second) ? qs_status::multiple_found : qs_status::found;
+                    };
+                };
+
+/**********************
+    PARALLEL
+***********************/
+            // Threads 'qs_parallel::run' hands its chunks to (there is no 'std::execution::par' in C++11), they are started
+            //  the first time they are needed and they are kept until exit.
+            class qs_thread_pool {
+                public:
+                    static qs_thread_pool& instance() {
+                        static qs_thread_pool pool;
+                        return pool;
+                        };
+                    ~qs_thread_pool() {
+                        {
+                            std::lock_guard<std::mutex> lock(_mutex);
+                            _stop = true;
+                            }
+                        _ready.notify_all();
+                        std::for_each(_threads.begin(), _threads.end(), [](std::thread& thread) { thread.join(); });
+                        };
+
+                    // Number of threads, '0' if they could not be started
+                    std::size_t size() {
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        if (!_started) {
+                            _started = true;
+                            for (std::size_t i = 1; i < std::thread::hardware_concurrency(); ++i) { // callers work too
+                                try {
+                                    _threads.push_back(std::thread(&qs_thread_pool::__work, this));
+                                    }
+                                catch (std::system_error&) {
+                                    break; // no more threads available
+                                    }
+                                }
+                            }
+                        return _threads.size();
+                        };
+                    // Runs 'task' in the first idle thread, it must not throw
+                    void post(const std::function<void ()>& task) {
+                        {
+                            std::lock_guard<std::mutex> lock(_mutex);
+                            _tasks.push_back(task);
+                            }
+                        _ready.notify_one();
+                        };
+
+                private:
+                    qs_thread_pool() : _started(false), _stop(false) {};
+                    qs_thread_pool(const qs_thread_pool&);
+                    qs_thread_pool& operator=(const qs_thread_pool&);
+
+                    void __work() {
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        while (true) {
+                            _ready.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+                            if (_tasks.empty()) {
+                                return;
+                                }
+                            std::function<void ()> task = std::move(_tasks.front());
+                            _tasks.pop_front();
+                            lock.unlock();
+                            task();
+                            lock.lock();
+                            }
+                        };
+
+                    std::mutex _mutex;
+                    std::condition_variable _ready;
+                    std::deque<std::function<void ()> > _tasks;
+                    std::vector<std::thread> _threads;
+                    bool _started;
+                    bool _stop;
+                };
+
+            // Chunks of a 'qs_parallel::run' call: every thread that works on it (the caller too) takes the next chunk
+            //  until there are none left, so the caller never waits for a chunk nobody took.
+            class qs_parallel_job {
+                public:
+                    qs_parallel_job(std::size_t chunks, const std::function<void (std::size_t)>& body) : _body(&body), _errors(chunks), _next(0), _done(0) {};
+
+                    void work() {
+                        for (std::size_t chunk = _next++; chunk < _errors.size(); chunk = _next++) {
+                            try {
+                                (*_body)(chunk);
+                                }
+                            catch (...) {
+                                _errors[chunk] = std::current_exception();
+                                }
+                            std::lock_guard<std::mutex> lock(_mutex);
+                            if (++_done == _errors.size()) {
+                                _finished.notify_all();
+                                }
+                            }
+                        };
+                    // Waits for the chunks taken by other threads, exceptions are rethrown here
+                    void wait() {
+                        {
+                            std::unique_lock<std::mutex> lock(_mutex);
+                            _finished.wait(lock, [this]() { return _done == _errors.size(); });
+                            }
+                        for (std::size_t chunk = 0; chunk < _errors.size(); ++chunk) {
+                            if (_errors[chunk]) {
+                                std::rethrow_exception(_errors[chunk]);
+                                }
+                            }
+                        };
+
+                private:
+                    const std::function<void (std::size_t)>* _body; // only called for chunks taken while the caller waits
+                    std::vector<std::exception_ptr> _errors;
+                    std::atomic<std::size_t> _next;
+                    std::size_t _done;
+                    std::mutex _mutex;
+                    std::condition_variable _finished;
+                };
+
+            struct qs_parallel {
+                // Number of chunks (one thread each) to split 'size' items into
+                static std::size_t chunks(std::size_t size) {
+                    std::size_t threads = std::thread::hardware_concurrency();
+                    std::size_t chunks = size / QS_MANAGER_PARALLEL_MIN_CHUNK;
+                    return (std::max)(std::size_t(1), (std::min)(threads, chunks));
+                    };
+
+                // Calls 'func(chunk, begin, end)' for each chunk of [0, size) in the threads of 'qs_thread_pool' and in the
+                //  calling thread. Exceptions are rethrown in the calling thread.
+                template <class Func>
+                static void run(std::size_t size, std::size_t chunks, const Func& func) {
+                    std::function<void (std::size_t)> body = [&func, size, chunks](std::size_t chunk) {
+                        func(chunk, size*chunk/chunks, size*(chunk+1)/chunks);
+                        };
+                    std::shared_ptr<qs_parallel_job> job = std::make_shared<qs_parallel_job>(chunks, body);
+                    if (chunks > 1) {
+                        qs_thread_pool& pool = qs_thread_pool::instance();
+                        std::size_t helpers = (std::min)(chunks - 1, pool.size());
+                        for (std::size_t i = 0; i < helpers; ++i) {
+                            try {
+                                pool.post([job]() { job->work(); });
+                                }
+                            catch (...) {
+                                break; // the caller takes the rest
+                                }
+                            }
+                        }
+                    job->work();
+                    job->wait();
+                    };
+                };
+
+            // Appends to 'results' the items in [first, last) that pass 'func', keeping their order.
+            template <class Iterator, class T, class Func>
+            void parallel_filter(Iterator first, Iterator last, std::size_t, const Func& func, std::vector<T>& results, std::input_iterator_tag) {
+                for (; first != last; ++first) {
+                    if (func(*first)) {
+                        results.push_back(*first);
+                        }
+                    }
+                };
+
+            // Contiguous storage: each thread filters its chunk into its own buffer, then they are merged.
+            template <class Iterator, class T, class Func>
+            void parallel_filter(Iterator first, Iterator last, std::size_t size, const Func& func, std::vector<T>& results, std::random_access_iterator_tag) {
+                std::size_t chunks = qs_parallel::chunks(size);
+                if (chunks == 1) {
+                    parallel_filter(first, last, size, func, results, std::input_iterator_tag());
+                    return;
+                    }
+                std::vector<std::vector<T> > partial(chunks);
+                qs_parallel::run(size, chunks, [&first, &func, &partial](std::size_t chunk, std::size_t begin, std::size_t end) {
+                    for (Iterator it = first + begin, it_end = first + end; it != it_end; ++it) {
+                        if (func(*it)) {
+                            partial[chunk].push_back(*it);
+                            }
+                        }
+                    });
+                std::size_t total = results.size();
+                for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+                    total += partial[chunk].size();
+                    }
+                results.reserve(total);
+                for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+                    results.insert(results.end(), std::make_move_iterator(partial[chunk].begin()), std::make_move_iterator(partial[chunk].end()));
+                    }
+                };
+
+            // Reduces [first, last) into 'acc' calling 'func(acc, item)' for every item
+            template <class Iterator, class Acc, class Func, class Combine>
+            Acc parallel_reduce(Iterator first, Iterator last, std::size_t, Acc acc, const Func& func, const Combine&, std::input_iterator_tag) {
+                for (; first != last; ++first) {
+                    func(acc, *first);
+                    }
+                return acc;
+                };
+
+            // Contiguous storage: each thread reduces its chunk starting from 'identity', then the partial results are
+            //  merged in order calling 'combine(acc, partial)'.
+            template <class Iterator, class Acc, class Func, class Combine>
+            Acc parallel_reduce(Iterator first, Iterator last, std::size_t size, Acc identity, const Func& func, const Combine& combine, std::random_access_iterator_tag) {
+                std::size_t chunks = qs_parallel::chunks(size);
+                if (chunks == 1) {
+                    return parallel_reduce(first, last, size, identity, func, combine, std::input_iterator_tag());
+                    }
+                std::vector<Acc> partial(chunks, identity);
+                qs_parallel::run(size, chunks, [&first, &func, &partial](std::size_t chunk, std::size_t begin, std::size_t end) {
+                    for (Iterator it = first + begin, it_end = first + end; it != it_end; ++it) {
+                        func(partial[chunk], *it);
+                        }
+                    });
+                for (std::size_t chunk = 1; chunk < chunks; ++chunk) {
+                    combine(partial[0], partial[chunk]);
+                    }
+                return partial[0];
+                };
+
+            // The 'k' first objects in the order given by 'before' (position in the container breaks ties, like a stable sort)
+            //  keeping just 'k' pointers: a heap whose top is the last of them, so it is replaced by better objects
+            template <class T, class Compare>
+            class qs_top_k {
+                public:
+                    typedef std::pair<const T*, std::size_t> value_type;
+
+                    qs_top_k(std::size_t k, const Compare& before) : _k(k), _order(before) {};
+
+                    void reserve(std::size_t size) {
+                        _heap.reserve((std::min)(_k, size));
+                        };
+                    void push(const T& item, std::size_t position) {
+                        value_type value(&item, position);
+                        if (_heap.size() < _k) {
+                            _heap.push_back(value);
+                            std::push_heap(_heap.begin(), _heap.end(), _order);
+                            }
+                        else if (_k != 0 && _order(value, _heap.front())) {
+                            std::pop_heap(_heap.begin(), _heap.end(), _order);
+                            _heap.back() = value;
+                            std::push_heap(_heap.begin(), _heap.end(), _order);
+                            }
+                        };
+                    void merge(const qs_top_k& other) {
+                        for (typename std::vector<value_type>::const_iterator it = other._heap.begin(); it != other._heap.end(); ++it) {
+                            this->push(*it->first, it->second);
+                            }
+                        };
+                    // Objects in order, it can be called only once
+                    const std::vector<value_type>& sorted() {
+                        std::sort_heap(_heap.begin(), _heap.end(), _order);
+                        return _heap;
+                        };
+
+                protected:
+                    struct order {
+                        explicit order(const Compare& before) : before(before) {};
+                        bool operator()(const value_type& lhs, const value_type& rhs) const {
+                            return before(*lhs.first, *rhs.first) || (!before(*rhs.first, *lhs.first) && lhs.second < rhs.second);
+                            };
+                        Compare before;
+                        };
+
+                    std::size_t _k;
+                    order _order;
+                    std::vector<value_type> _heap;
+                };
+
+            // Pushes into 'heap' the items in [first, last) that pass 'filter'
+            template <class Iterator, class T, class Compare, class Filter>
+            void parallel_top_k(Iterator first, Iterator last, std::size_t, qs_top_k<T, Compare>& heap, const Filter& filter, std::input_iterator_tag) {
+                for (std::size_t position = 0; first != last; ++first, ++position) {
+                    if (filter(*first)) {
+                        heap.push(*first, position);
+                        }
+                    }
+                };
+
+            // Contiguous storage: each thread keeps the best objects of its chunk in its own heap, then they are merged.
+            template <class Iterator, class T, class Compare, class Filter>
+            void parallel_top_k(Iterator first, Iterator last, std::size_t size, qs_top_k<T, Compare>& heap, const Filter& filter, std::random_access_iterator_tag) {
+                std::size_t chunks = qs_parallel::chunks(size);
+                if (chunks == 1) {
+                    parallel_top_k(first, last, size, heap, filter, std::input_iterator_tag());
+                    return;
+                    }
+                std::vector<qs_top_k<T, Compare> > partial(chunks, heap);
+                qs_parallel::run(size, chunks, [&first, &filter, &partial](std::size_t chunk, std::size_t begin, std::size_t end) {
+                    for (std::size_t position = begin; position != end; ++position) {
+                        if (filter(first[position])) {
+                            partial[chunk].push(first[position], position);
+                            }
+                        }
+                    });
+                for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+                    heap.merge(partial[chunk]);
+                    }
+                };
+
+/**********************
+    CONCURRENT READS
+***********************/
+            // Publishes immutable copies of the data (RCU): readers take the current one without locking, a new one
+            //  is only built (by one thread at a time) if the revision of the data changed or it is unknown. Old copies
+            //  live until the last reader releases them.
+            template <class Store>
+            class qs_manager_publisher {
+                public:
+                    qs_manager_publisher() {};
+                    qs_manager_publisher(const qs_manager_publisher&) {}; // each manager publishes its own copies
+                    qs_manager_publisher& operator=(const qs_manager_publisher&) { return *this; };
+
+                    // Current copy, 'build(revision)' is called if there is none or it is older than 'revision' (always if it
+                    //  is '0', unknown: the data may have changed)
+                    template <class Build>
+                    std::shared_ptr<const Store> get(std::size_t revision, const Build& build) const {
+                        std::shared_ptr<const Store> current = std::atomic_load(&_current);
+                        if (current && revision != 0 && current->revision() == revision) {
+                            return current;
+                            }
+                        return this->publish(revision, build, false);
+                        };
+
+                    template <class Build>
+                    std::shared_ptr<const Store> publish(std::size_t revision, const Build& build, bool force) const {
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        std::shared_ptr<const Store> current = std::atomic_load(&_current);
+                        if (!force && current && revision != 0 && current->revision() == revision) {
+                            return current; // published by another thread meanwhile
+                            }
+                        current = build(revision);
+                        std::atomic_store(&_current, current);
+                        return current;
+                        };
+
+                private:
+                    mutable std::shared_ptr<const Store> _current;
+                    mutable std::mutex _mutex;
+                };
+
+/**********************
+    CACHE
+***********************/
+            template <class ID>
+            struct is_hashable {
+                template <class U>
+                static auto test(int) -> decltype(std::hash<U>()(std::declval<const U&>()), std::true_type());
+                template <class U>
+                static std::false_type test(...);
+                static const bool value = decltype(test<ID>(0))::value;
+                };
+
+            template <class ID>
+            struct is_less_comparable {
+                template <class U>
+                static auto test(int) -> decltype(bool(std::declval<const U&>() < std::declval<const U&>()), std::true_type());
+                template <class U>
+                static std::false_type test(...);
+                static const bool value = decltype(test<ID>(0))::value;
+                };
+
+            // Ids can be kept in a qs_manager_cache (hashed if possible)
+            template <class ID>
+            struct is_cacheable : std::integral_constant<bool, is_hashable<ID>::value || is_less_comparable<ID>::value> {};
+
+            template <class ID, typename Enable = void>
+            struct qs_manager_cache_map {
+                typedef std::map<ID, std::size_t> type;
+                };
+            template <class ID>
+            struct qs_manager_cache_map<ID, typename std::enable_if<is_hashable<ID>::value>::type> {
+                typedef std::unordered_map<ID, std::size_t> type;
+                };
+
+            /* Copies of the objects looked up by id, and of the ids that were not found, with CLOCK eviction: hits set the
+                'referenced' bit of their slot and the hand clears them while it looks for a slot to reuse, so hot ids stay.
+                Entries belong to a generation of the container ('0' if unknown), they are dropped when it changes.
+            */
+            template <class T, class ID>
+            class qs_manager_cache {
+                public:
+                    qs_manager_cache() : _capacity(0), _hand(0), _revision(0) {};
+                    qs_manager_cache(const qs_manager_cache& other) : _capacity(other._capacity), _hand(0), _revision(0) {}; // each manager caches its own lookups
+                    qs_manager_cache& operator=(const qs_manager_cache& other) {
+                        _capacity = other._capacity;
+                        this->clear();
+                        return *this;
+                        };
+
+                    bool enabled() const { return _capacity != 0; };
+                    void capacity(std::size_t capacity) {
+                        _capacity = capacity;
+                        this->clear();
+                        };
+                    void clear() const {
+                        _slots.clear();
+                        _ids.clear();
+                        _hand = 0;
+                        };
+                    void erase(const ID& id) const {
+                        typename map_type::iterator it = _ids.find(id);
+                        if (it != _ids.end()) {
+                            _slots[it->second].valid = false;
+                            _ids.erase(it);
+                            }
+                        };
+
+                    // Result cached for 'id' if there is one
+                    bool find(const ID& id, std::size_t revision, qs_lookup<T>& found) const {
+                        if (revision != _revision) {
+                            this->clear();
+                            _revision = revision;
+                            return false;
+                            }
+                        typename map_type::const_iterator it = _ids.find(id);
+                        if (it == _ids.end()) {
+                            return false;
+                            }
+                        slot& cached = _slots[it->second];
+                        cached.referenced = true;
+                        found = qs_lookup<T>(cached.status, cached.object.get());
+                        return true;
+                        };
+
+                    // Keeps the result of looking for 'id' (not cached yet), the returned one points to the copy
+                    qs_lookup<T> insert(const ID& id, const qs_lookup<T>& found) const {
+                        std::size_t pos = _slots.size();
+                        if (pos < _capacity) {
+                            _slots.push_back(slot());
+                            }
+                        else {
+                            while (_slots[_hand].valid && _slots[_hand].referenced) {
+                                _slots[_hand].referenced = false;
+                                _hand = (_hand + 1) % _slots.size();
+                                }
+                            pos = _hand;
+                            _hand = (_hand + 1) % _slots.size();
+                            if (_slots[pos].valid) {
+                                _ids.erase(_slots[pos].id);
+                                }
+                            }
+                        slot& cached = _slots[pos];
+                        cached.id = id;
+                        cached.object.reset((found.status == qs_status::found) ? new T(*found.object) : nullptr);
+                        cached.status = found.status;
+                        cached.valid = true;
+                        cached.referenced = false;
+                        _ids[id] = pos;
+                        return qs_lookup<T>(cached.status, cached.object.get());
+                        };
+
+                private:
+                    typedef typename qs_manager_cache_map<ID>::type map_type;
+                    struct slot {
+                        slot() : status(qs_status::not_found), valid(false), referenced(false) {};
+                        ID id;
+                        std::unique_ptr<T> object;
+                        qs_status status;
+                        bool valid;
+                        bool referenced;
+                        };
+
+                    std::size_t _capacity;
+                    mutable std::vector<slot> _slots;
+                    mutable map_type _ids;
+                    mutable std::size_t _hand;
+                    mutable std::size_t _revision;
+                };
+
+/**********************
+    SECONDARY INDEXES
+***********************/
+            // Key of an object: a member ('&T::field'), a method ('&T::name') or a function ('key(item)')
+            template <class M, class C, class T>
+            const M& call_key(M C::* member, const T& item, typename std::enable_if<!std::is_function<M>::value>::type* = nullptr) {
+                return item.*member;
+                };
+            template <class R, class C, class T>
+            R call_key(R (C::* method)() const, const T& item) {
+                return (item.*method)();
+                };
+            template <class Extractor, class T>
+            auto call_key(const Extractor& key, const T& item) -> decltype(key(item)) {
+                return key(item);
+                };
+
+            template <class T, class Extractor>
+            struct key_type_of {
+                typedef typename std::decay<decltype(call_key(std::declval<const Extractor&>(), std::declval<const T&>()))>::type type;
+                };
+
+            // True if 'Order' compares two objects ('before(lhs, rhs)'), otherwise it is a key (see 'call_key')
+            template <class T, class Order>
+            struct is_comparator {
+                template <class U>
+                static auto test(int) -> decltype(std::declval<const U&>()(std::declval<const T&>(), std::declval<const T&>()), std::true_type());
+                template <class U>
+                static std::false_type test(...);
+                static const bool value = decltype(test<Order>(0))::value;
+                };
+
+            // Orders objects by a key
+            template <class T, class Extractor>
+            struct qs_key_order {
+                qs_key_order(const Extractor& key, bool descending) : key(key), descending(descending) {};
+                bool operator()(const T& lhs, const T& rhs) const {
+                    return descending ? call_key(key, rhs) < call_key(key, lhs) : call_key(key, lhs) < call_key(key, rhs);
+                    };
+                Extractor key;
+                bool descending;
+                };
+
+            template <class T>
+            class qs_secondary_index_base {
+                public:
+                    virtual ~qs_secondary_index_base() {};
+                    // True if the index is on the key 'extractor' (of type 'type') returns
+                    virtual bool uses(const std::type_info& type, const void* extractor) const = 0;
+                    // New empty index on the same key, for copies of the manager (see 'qs_manager_indexes')
+                    virtual qs_secondary_index_base* clone() const = 0;
+                    // True if the index is built for the table of 'epoch'
+                    virtual bool built(std::size_t epoch) const = 0;
+                    // Adds the key of an object inserted or updated in slot 'slot', if the index is built for 'epoch'
+                    virtual void insert(const T& item, std::size_t slot, std::size_t epoch) const = 0;
+                };
+
+            template <class T, class Key> class qs_index_key; // forward declaration
+
+            // Table of objects the secondary indexes refer to (see 'qs_manager_indexes')
+            template <class T>
+            struct qs_manager_items {
+                typedef std::vector<const T*, qs_allocator<const T*> > type;
+                };
+
+            // Index on a key of the objects: it stores their slots in the table of the manager (see 'qs_manager_indexes'),
+            //  it is built the first time it is used after the table is taken again. Changes applied to the table only add
+            //  keys, the entries they make stale are discarded when the objects are checked.
+            template <class T, class Key>
+            class qs_secondary_index : public qs_secondary_index_base<T> {
+                public:
+                    qs_secondary_index() : _epoch(0), _origin(nullptr) {};
+
+                    virtual Key key(const T& item) const = 0;
+
+                    // Handles ('qs_index') of the index this one was cloned from are recognized too
+                    bool uses(const std::type_info& type, const void* extractor) const {
+                        if (type != typeid(qs_index_key<T, Key>)) {
+                            return false;
+                            }
+                        const qs_secondary_index<T, Key>* index = static_cast<const qs_index_key<T, Key>*>(extractor)->index();
+                        return index == this || (_origin != nullptr && index == _origin);
+                        };
+
+                    bool built(std::size_t epoch) const {
+                        return epoch == _epoch;
+                        };
+                    void insert(const T& item, std::size_t slot, std::size_t epoch) const {
+                        if (epoch == _epoch) {
+                            this->__add(this->key(item), slot);
+                            }
+                        };
+
+                    // Slots of the objects with key 'value'
+                    void equal(const Key& value, const typename qs_manager_items<T>::type& items, std::size_t epoch, std::vector<std::size_t>& positions) const {
+                        this->__update(items, epoch);
+                        this->__equal(value, positions);
+                        };
+                    // Slots of the objects with key in [lo, hi), false if the index cannot do it
+                    bool range(const Key& lo, const Key& hi, const typename qs_manager_items<T>::type& items, std::size_t epoch, std::vector<std::size_t>& positions) const {
+                        if (!this->__ordered()) {
+                            return false;
+                            }
+                        this->__update(items, epoch);
+                        this->__range(lo, hi, positions);
+                        return true;
+                        };
+
+                protected:
+                    void __update(const typename qs_manager_items<T>::type& items, std::size_t epoch) const {
+                        if (epoch != _epoch) {
+                            this->__build(items);
+                            _epoch = epoch;
+                            }
+                        };
+                    void __clone_of(const qs_secondary_index& other) {
+                        _origin = (other._origin != nullptr) ? other._origin : &other;
+                        };
+
+                    virtual bool __ordered() const = 0;
+                    virtual void __build(const typename qs_manager_items<T>::type& items) const = 0;
+                    virtual void __add(const Key& key, std::size_t slot) const = 0;
+                    virtual void __equal(const Key& value, std::vector<std::size_t>& positions) const = 0;
+                    virtual void __range(const Key&, const Key&, std::vector<std::size_t>&) const {};
+
+                    mutable std::size_t _epoch;
+                    const qs_secondary_index* _origin; // index of the manager this one was copied from
+                };
+
+            // Key extraction for the indexes, only member pointers are recognized in predicates (functions cannot be compared)
+            template <class T, class Key, class Extractor>
+            class qs_secondary_index_by : public qs_secondary_index<T, Key> {
+                public:
+                    explicit qs_secondary_index_by(const Extractor& extractor) : _extractor(extractor) {};
+
+                    Key key(const T& item) const {
+                        return call_key(_extractor, item);
+                        };
+
+                    bool uses(const std::type_info& type, const void* extractor) const {
+                        return qs_secondary_index<T, Key>::uses(type, extractor) ||
+                            (type == typeid(Extractor) && this->same(*static_cast<const Extractor*>(extractor), std::integral_constant<bool, std::is_member_pointer<Extractor>::value>()));
+                        };
+
+                protected:
+                    bool same(const Extractor& extractor, std::true_type) const { return extractor == _extractor; };
+                    bool same(const Extractor&, std::false_type) const { return false; };
+
+                    Extractor _extractor;
+                };
+
+            // Hashed index, only for equality
+            template <class T, class Key, class Extractor>
+            class qs_hash_index : public qs_secondary_index_by<T, Key, Extractor> {
+                public:
+                    qs_hash_index(const Extractor& extractor, qs_memory_resource* resource)
+                        : qs_secondary_index_by<T, Key, Extractor>(extractor), _index(allocator_type(resource)) {};
+
+                    qs_secondary_index_base<T>* clone() const {
+                        qs_hash_index* index = new qs_hash_index(this->_extractor, _index.get_allocator().resource());
+                        index->__clone_of(*this);
+                        return index;
+                        };
+
+                protected:
+                    typedef qs_allocator<std::pair<const Key, std::size_t> > allocator_type;
+                    typedef std::unordered_multimap<Key, std::size_t, std::hash<Key>, std::equal_to<Key>, allocator_type> index_type;
+
+                    bool __ordered() const { return false; };
+                    void __build(const typename qs_manager_items<T>::type& items) const {
+                        _index.clear();
+                        _index.reserve(items.size());
+                        for (std::size_t i = 0; i < items.size(); ++i) {
+                            _index.insert(std::make_pair(this->key(*items[i]), i));
+                            }
+                        };
+                    void __add(const Key& key, std::size_t slot) const {
+                        _index.insert(std::make_pair(key, slot));
+                        };
+                    void __equal(const Key& value, std::vector<std::size_t>& positions) const {
+                        typedef typename index_type::const_iterator iterator;
+                        std::pair<iterator, iterator> range = _index.equal_range(value);
+                        for (iterator it = range.first; it != range.second; ++it) {
+                            positions.push_back(it->second);
+                            }
+                        };
+
+                    mutable index_type _index;
+                };
+
+            // Sorted index (see 'qs_sorted_vector'), for equality and ranges. Keys added after it was built go to a tree
+            //  until the next build, so they don't move the sorted ones.
+            template <class T, class Key, class Extractor>
+            class qs_ordered_index : public qs_secondary_index_by<T, Key, Extractor> {
+                public:
+                    explicit qs_ordered_index(const Extractor& extractor) : qs_secondary_index_by<T, Key, Extractor>(extractor) {};
+
+                    qs_secondary_index_base<T>* clone() const {
+                        qs_ordered_index* index = new qs_ordered_index(this->_extractor);
+                        index->__clone_of(*this);
+                        return index;
+                        };
+
+                protected:
+                    typedef qs_sorted_vector<Key, std::size_t> index_type;
+
+                    bool __ordered() const { return true; };
+                    void __build(const typename qs_manager_items<T>::type& items) const {
+                        std::vector<typename index_type::value_type> data;
+                        data.reserve(items.size());
+                        for (std::size_t i = 0; i < items.size(); ++i) {
+                            data.push_back(std::make_pair(this->key(*items[i]), i));
+                            }
+                        index_type(std::move(data)).swap(_index);
+                        _added.clear();
+                        };
+                    void __add(const Key& key, std::size_t slot) const {
+                        _added.insert(std::make_pair(key, slot));
+                        };
+                    void __equal(const Key& value, std::vector<std::size_t>& positions) const {
+                        this->__slots(_index.equal_range(value), positions);
+                        this->__slots(_added.equal_range(value), positions);
+                        };
+                    void __range(const Key& lo, const Key& hi, std::vector<std::size_t>& positions) const {
+                        if (lo < hi) {
+                            this->__slots(std::make_pair(_index.lower_bound(lo), _index.lower_bound(hi)), positions);
+                            this->__slots(std::make_pair(_added.lower_bound(lo), _added.lower_bound(hi)), positions);
+                            }
+                        };
+                    template <class Iterator>
+                    void __slots(const std::pair<Iterator, Iterator>& range, std::vector<std::size_t>& positions) const {
+                        for (Iterator it = range.first; it != range.second; ++it) {
+                            positions.push_back(it->second);
+                            }
+                        };
+
+                    mutable index_type _index;
+                    mutable std::multimap<Key, std::size_t> _added;
+                };
+
+            // Key of the objects through an index (predicates built from a 'qs_index' are recognized by it)
+            template <class T, class Key>
+            class qs_index_key {
+                public:
+                    explicit qs_index_key(const qs_secondary_index<T, Key>* index) : _index(index) {};
+                    Key operator()(const T& item) const { return _index->key(item); };
+                    const qs_secondary_index<T, Key>* index() const { return _index; };
+                private:
+                    const qs_secondary_index<T, Key>* _index;
+                };
+
+            // Views over the values of a map (see 'second_iterator'), the rest are views over vectors
+            template <class Iterator>
+            struct is_map_view : std::false_type {};
+            template <class MapIterator>
+            struct is_map_view<second_iterator<MapIterator> > : std::true_type {};
+
+            /* Secondary indexes of a manager and the table of objects they refer to by slot. The table is taken again if the
+                data changed, but changes notified by the container (see 'apply') are applied to it and to the built indexes:
+                erased objects leave a tombstone (the position of each slot in a vector is kept by 'qs_manager_slots', an
+                id to slot map locates the objects of a map), inserted objects get a new slot and the indexes get their
+                keys, stale entries are discarded when the objects are checked. The table is taken again after too many
+                changes, when an index has to be built (it is built from the table) or if the change cannot be located.
+            */
+            template <class T, class ID>
+            class qs_manager_indexes {
+                public:
+                    typedef qs_secondary_index_base<T> index_type;
+
+                    qs_manager_indexes() : _observed(false), _located(false), _appended(false), _epoch(0), _changes(0) {};
+                    // Copies have their own indexes and table, nothing built by 'other' is shared with them
+                    qs_manager_indexes(const qs_manager_indexes& other) : _items(other._items.get_allocator()), _observed(other._observed),
+                            _located(false), _appended(false), _epoch(other._epoch), _changes(0) {
+                        for (typename std::vector<std::shared_ptr<index_type> >::const_iterator it = other._indexes.begin(); it != other._indexes.end(); ++it) {
+                            _indexes.push_back(std::shared_ptr<index_type>((*it)->clone()));
+                            }
+                        _slots.resource(other.resource());
+                        };
+
+                    // Memory for the table and the hashed indexes (see 'qs_memory_resource')
+                    void resource(qs_memory_resource* resource) {
+                        _built.invalidate();
+                        typename qs_manager_items<T>::type(qs_allocator<const T*>(resource)).swap(_items);
+                        _slots.resource(resource);
+                        };
+                    qs_memory_resource* resource() const {
+                        return _items.get_allocator().resource();
+                        };
+                    // The container notifies its changes, maps keep the slot of each id to apply them
+                    void observe() {
+                        _observed = true;
+                        };
+
+                    void add(const std::shared_ptr<index_type>& index) {
+                        _indexes.push_back(index);
+                        };
+                    bool empty() const {
+                        return _indexes.empty();
+                        };
+
+                    // Index on 'extractor' with keys of type 'Key', 'nullptr' if there is none
+                    template <class Key, class Extractor>
+                    const qs_secondary_index<T, Key>* find(const Extractor& extractor) const {
+                        for (typename std::vector<std::shared_ptr<index_type> >::const_iterator it = _indexes.begin(); it != _indexes.end(); ++it) {
+                            if ((*it)->uses(typeid(Extractor), &extractor)) {
+                                const qs_secondary_index<T, Key>* index = dynamic_cast<const qs_secondary_index<T, Key>*>(it->get());
+                                if (index) {
+                                    return index;
+                                    }
+                                }
+                            }
+                        return nullptr;
+                        };
+
+                    // Table to query 'index' on the data of 'revision' (see 'qs_manager_built_revision'), it is taken again from
+                    //  'view' if the data changed, or if 'index' has to be built and changes were applied to the table
+                    template <class View>
+                    const typename qs_manager_items<T>::type& items(const index_type& index, const View& view, std::size_t revision) const {
+                        if (!_built.current(revision) || (_changes != 0 && !index.built(_epoch))) {
+                            this->__build(view, is_map_view<typename View::const_iterator>());
+                            _built.built(revision);
+                            _changes = 0;
+                            _appended = false;
+                            ++_epoch;
+                            }
+                        return _items;
+                        };
+                    std::size_t epoch() const {
+                        return _epoch;
+                        };
+                    void invalidate() const {
+                        _built.invalidate();
+                        };
+
+                    // Applies a change notified by the container to the table built for revision 'previous', 'view' is the data
+                    //  already changed and 'place' where the change happened (see 'qs_change_place')
+                    template <class View>
+                    void apply(qs_change change, const ID& id, const qs_change_place<T>& place, const View& view, std::size_t previous, std::size_t revision) const {
+                        if (!place.known || !_built.current(previous) || !this->__apply(change, id, place, view, is_map_view<typename View::const_iterator>())) {
+                            _built.invalidate();
+                            return;
+                            }
+                        _built.built(revision);
+                        if (++_changes > 64 + _items.size() / 8) {
+                            _built.invalidate();
+                            }
+                        };
+
+                    // Objects at the 'slots' an index returned (they may be repeated or erased), in the order of the container
+                    template <class View>
+                    void objects(const View& view, std::vector<std::size_t>& slots, std::vector<const T*>& objects) const {
+                        std::sort(slots.begin(), slots.end());
+                        slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+                        this->__objects(view, slots, objects, is_map_view<typename View::const_iterator>());
+                        };
+
+                private:
+                    typedef typename qs_manager_cache_map<ID>::type locator_type;
+
+                    qs_manager_indexes& operator=(const qs_manager_indexes&);
+
+                    template <class View>
+                    void __items(const View& view) const {
+                        _items.clear();
+                        _items.reserve(view.size());
+                        for (typename View::const_iterator it = view.begin(); it != view.end(); ++it) {
+                            _items.push_back(&*it);
+                            }
+                        };
+                    void __insert(const T& item, std::size_t slot) const {
+                        for (typename std::vector<std::shared_ptr<index_type> >::const_iterator it = _indexes.begin(); it != _indexes.end(); ++it) {
+                            (*it)->insert(item, slot, _epoch);
+                            }
+                        };
+
+                    // - vectors: slot 'i' is position 'i' when the table is built
+                    template <class View>
+                    void __build(const View& view, std::false_type) const {
+                        this->__items(view);
+                        _slots.reset(_items.size());
+                        };
+                    template <class View>
+                    bool __apply(qs_change change, const ID&, const qs_change_place<T>& place, const View& view, std::false_type) const {
+                        std::size_t slot = 0;
+                        switch (change) {
+                            case qs_change::insert:
+                                if (view.size() != _slots.size() + 1 || place.position + 1 != view.size()) {
+                                    return false;
+                                    }
+                                slot = _slots.append();
+                                break;
+                            case qs_change::erase:
+                                if (view.size() + 1 != _slots.size() || place.position >= _slots.size()) {
+                                    return false;
+                                    }
+                                _slots.erase(_slots.slot(place.position));
+                                return true;
+                            case qs_change::update:
+                                if (view.size() != _slots.size() || place.position >= view.size()) {
+                                    return false;
+                                    }
+                                slot = _slots.slot(place.position);
+                                break;
+                            }
+                        this->__insert(view.begin()[place.position], slot);
+                        return true;
+                        };
+                    template <class View>
+                    void __objects(const View& view, const std::vector<std::size_t>& slots, std::vector<const T*>& objects, std::false_type) const {
+                        for (std::vector<std::size_t>::const_iterator it = slots.begin(); it != slots.end(); ++it) {
+                            if (_slots.alive(*it)) {
+                                objects.push_back(&view.begin()[_slots.position(*it)]);
+                                }
+                            }
+                        };
+
+                    // - maps: objects don't move (but in sorted vectors), they are kept in the table with the slot of each id
+                    template <class View>
+                    void __build(const View& view, std::true_type) const {
+                        typedef typename std::iterator_traits<typename View::const_iterator>::iterator_category category;
+                        this->__items(view);
+                        _locator.clear();
+                        _ids.clear();
+                        _located = _observed && !std::is_base_of<std::random_access_iterator_tag, category>::value;
+                        if (_located) {
+                            _ids.reserve(_items.size());
+                            for (typename View::const_iterator it = view.begin(); it != view.end(); ++it) {
+                                std::pair<typename locator_type::iterator, bool> ret = _locator.insert(std::make_pair(it.base()->first, _ids.size()));
+                                if (!ret.second) {
+                                    _located = false; // repeated ids
+                                    break;
+                                    }
+                                _ids.push_back(&ret.first->first);
+                                }
+                            }
+                        };
+                    template <class View>
+                    bool __apply(qs_change change, const ID& id, const qs_change_place<T>& place, const View&, std::true_type) const {
+                        typename locator_type::iterator it = _located ? _locator.find(id) : _locator.end();
+                        if (!_located || (it == _locator.end()) != (change == qs_change::insert) || (change != qs_change::erase && !place.object)) {
+                            return false;
+                            }
+                        switch (change) {
+                            case qs_change::insert:
+                                it = _locator.insert(std::make_pair(id, _items.size())).first;
+                                _ids.push_back(&it->first);
+                                _items.push_back(place.object);
+                                _appended = true;
+                                break;
+                            case qs_change::erase:
+                                _items[it->second] = nullptr;
+                                _ids[it->second] = nullptr;
+                                _locator.erase(it);
+                                return true;
+                            case qs_change::update:
+                                _items[it->second] = place.object;
+                                break;
+                            }
+                        this->__insert(*place.object, it->second);
+                        return true;
+                        };
+                    template <class View>
+                    void __objects(const View&, std::vector<std::size_t>& slots, std::vector<const T*>& objects, std::true_type) const {
+                        slots.erase(std::remove_if(slots.begin(), slots.end(), [this](std::size_t slot) { return _items[slot] == nullptr; }), slots.end());
+                        if (_appended) {
+                            this->__order(slots, typename std::iterator_traits<typename View::const_iterator>::iterator_category());
+                            }
+                        for (std::vector<std::size_t>::const_iterator it = slots.begin(); it != slots.end(); ++it) {
+                            objects.push_back(_items[*it]);
+                            }
+                        };
+                    // Objects inserted in ordered maps go to the order of their ids, not to the end
+                    void __order(std::vector<std::size_t>& slots, std::bidirectional_iterator_tag) const {
+                        std::sort(slots.begin(), slots.end(), [this](std::size_t lhs, std::size_t rhs) { return *_ids[lhs] < *_ids[rhs]; });
+                        };
+                    void __order(std::vector<std::size_t>&, std::forward_iterator_tag) const {};
+
+                    std::vector<std::shared_ptr<index_type> > _indexes;
+                    mutable typename qs_manager_items<T>::type _items; // maps: objects by slot ('nullptr' if erased)
+                    mutable qs_manager_slots _slots;                   // vectors: position of each slot
+                    mutable locator_type _locator;                     // maps: slot of each id
+                    mutable std::vector<const ID*> _ids;               // maps: id of each slot (in '_locator')
+                    bool _observed;
+                    mutable bool _located;
+                    mutable bool _appended;
+                    mutable std::size_t _epoch;
+                    mutable std::size_t _changes; // applied since the table was taken
+                    qs_manager_built_revision _built;
+                };
+
+            }
+
+        // Predicates for 'qs_manager::filter': objects whose key (a member, a method or a function) is equal to 'value'
+        //  or in [lo, hi). The manager uses a secondary index on that key if there is one (see 'qs_manager::index_by').
+        template <class Extractor, class Key>
+        struct qs_eq_t {
+            Extractor key;
+            Key value;
+
+            template <class T>
+            bool operator()(const T& item) const {
+                return _private::call_key(key, item) == value;
+                };
+            };
+
+        template <class Extractor, class Key>
+        struct qs_range_t {
+            Extractor key;
+            Key lo;
+            Key hi;
+
+            template <class T>
+            bool operator()(const T& item) const {
+                const Key& k = _private::call_key(key, item);
+                return !(k < lo) && k < hi;
+                };
+            };
+
+        template <class M, class C, class Value>
+        typename std::enable_if<!std::is_function<M>::value, qs_eq_t<M C::*, M> >::type qs_eq(M C::* member, const Value& value) {
+            qs_eq_t<M C::*, M> ret = { member, M(value) };
+            return ret;
+            };
+        template <class R, class C, class Value>
+        qs_eq_t<R (C::*)() const, typename std::decay<R>::type> qs_eq(R (C::* method)() const, const Value& value) {
+            qs_eq_t<R (C::*)() const, typename std::decay<R>::type> ret = { method, typename std::decay<R>::type(value) };
+            return ret;
+            };
+        template <class Extractor, class Key>
+        typename std::enable_if<!std::is_member_pointer<Extractor>::value, qs_eq_t<Extractor, Key> >::type qs_eq(const Extractor& key, const Key& value) {
+            qs_eq_t<Extractor, Key> ret = { key, value };
+            return ret;
+            };
+
+        template <class M, class C, class Value>
+        typename std::enable_if<!std::is_function<M>::value, qs_range_t<M C::*, M> >::type qs_range(M C::* member, const Value& lo, const Value& hi) {
+            qs_range_t<M C::*, M> ret = { member, M(lo), M(hi) };
+            return ret;
+            };
+        template <class R, class C, class Value>
+        qs_range_t<R (C::*)() const, typename std::decay<R>::type> qs_range(R (C::* method)() const, const Value& lo, const Value& hi) {
+            typedef typename std::decay<R>::type key_type;
+            qs_range_t<R (C::*)() const, key_type> ret = { method, key_type(lo), key_type(hi) };
+            return ret;
+            };
+        template <class Extractor, class Key>
+        typename std::enable_if<!std::is_member_pointer<Extractor>::value, qs_range_t<Extractor, Key> >::type qs_range(const Extractor& key, const Key& lo, const Key& hi) {
+            qs_range_t<Extractor, Key> ret = { key, lo, hi };
+            return ret;
+            };
+
+        // Handle to a secondary index of a qs_manager (see 'qs_manager::index_by'), valid while the manager is alive. Copies
+        //  of the manager have their own copy of the index and they recognize it too.
+        template <class T, class Key>
+        class qs_index {
+            public:
+                typedef qs_eq_t<_private::qs_index_key<T, Key>, Key> eq_type;
+                typedef qs_range_t<_private::qs_index_key<T, Key>, Key> range_type;
+
+                explicit qs_index(const _private::qs_secondary_index<T, Key>* index) : _key(index) {};
+
+                eq_type eq(const Key& value) const {
+                    eq_type ret = { _key, value };
+                    return ret;
+                    };
+                range_type range(const Key& lo, const Key& hi) const {
+                    range_type ret = { _key, lo, hi };
+                    return ret;
+                    };
+
+            private:
+                _private::qs_index_key<T, Key> _key;
+            };
+
+        /* Lazy query on the objects of a manager (see 'qs_manager::query'), Django style:
+                manager.query().filter(...).exclude(...).order_by(&T::name).offset(10).limit(5).all()
+            Nothing is done until it is evaluated ('all', 'first', 'exists', 'count' or 'for_each'), then the objects are
+            visited just once checking every filter: 'first' and 'exists' stop at the first match, 'count' doesn't copy
+            anything and 'order_by' sorts pointers to the objects (only the first 'offset + limit' if there is a limit).
+            It refers to the data of the source, so it is valid while the source is alive.
+        */
+        template <class T, class Source>
+        class qs_queryset {
+            public:
+                typedef std::function<bool (const T&)> predicate_type;
+                typedef typename Source::view_type view_type;
+
+                static const std::size_t no_limit = std::size_t(-1);
+
+            public:
+                explicit qs_queryset(const Source& source) : _source(&source), _offset(0), _limit(no_limit) {};
+
+                // Objects that pass 'predicate' (or don't, for 'exclude'), they are added to the previous filters
+                template <class Predicate>
+                qs_queryset filter(const Predicate& predicate) const {
+                    qs_queryset ret(*this);
+                    ret._filters.push_back(predicate_type(predicate));
+                    return ret;
+                    };
+                template <class Predicate>
+                qs_queryset exclude(const Predicate& predicate) const {
+                    qs_queryset ret(*this);
+                    ret._filters.push_back([predicate](const T& item) { return !predicate(item); });
+                    return ret;
+                    };
+
+                // Sort by a key (a member, a method or a function, see 'qs_eq'), it replaces the previous order. Objects with
+                //  the same key keep the order of the container.
+                template <class Extractor>
+                qs_queryset order_by(const Extractor& key, bool descending = false) const {
+                    qs_queryset ret(*this);
+                    ret._order = _private::qs_key_order<T, Extractor>(key, descending);
+                    return ret;
+                    };
+
+                // Slicing, applied to the result of the previous one (offset(10).limit(5) is [10, 15))
+                qs_queryset offset(std::size_t n) const {
+                    qs_queryset ret(*this);
+                    ret._offset = _offset + n;
+                    ret._limit = (_limit == no_limit) ? no_limit : ((_limit > n) ? _limit - n : 0);
+                    return ret;
+                    };
+                qs_queryset limit(std::size_t n) const {
+                    qs_queryset ret(*this);
+                    ret._limit = (std::min)(_limit, n);
+                    return ret;
+                    };
+
+                // Evaluation
+                std::vector<T> all() const {
+                    std::vector<T> ret;
+                    this->for_each([&ret](const T& item) { ret.push_back(item); });
+                    return ret;
+                    };
+                qs_lookup<T> first() const {
+                    const T* found = nullptr;
+                    this->limit(1).for_each([&found](const T& item) { found = &item; });
+                    return found ? qs_lookup<T>(qs_status::found, found) : qs_lookup<T>();
+                    };
+                bool exists() const {
+                    return this->__count(1) != 0;
+                    };
+                std::size_t count() const {
+                    return this->__count(_limit);
+                    };
+
+                template <class Func>
+                void for_each(const Func& func) const {
+                    if (_limit == 0) {
+                        return;
+                        }
+                    view_type view = _source->view();
+                    if (!_order) {
+                        std::size_t skip = _offset, left = _limit;
+                        for (typename view_type::const_iterator it = view.begin(); it != view.end(); ++it) {
+                            if (!this->__matches(*it)) {
+                                continue;
+                                }
+                            if (skip) {
+                                --skip;
+                                continue;
+                                }
+                            func(*it);
+                            if (left != no_limit && --left == 0) {
+                                return;
+                                }
+                            }
+                        return;
+                        }
+
+                    // Sort (position in the container breaks ties) just what is needed: with a limit only the first
+                    //  'offset + limit' matches are kept (see '_private::qs_top_k')
+                    std::size_t k = (_limit == no_limit || _offset > no_limit - _limit) ? no_limit : _offset + _limit;
+                    _private::qs_top_k<T, std::function<bool (const T&, const T&)> > heap(k, _order);
+                    heap.reserve(view.size());
+                    _private::parallel_top_k(view.begin(), view.end(), view.size(), heap, [this](const T& item) { return this->__matches(item); }, std::input_iterator_tag());
+                    const std::vector<std::pair<const T*, std::size_t> >& matches = heap.sorted();
+                    for (std::size_t i = _offset; i < matches.size(); ++i) {
+                        func(*matches[i].first);
+                        }
+                    };
+
+            protected:
+                bool __matches(const T& item) const {
+                    for (typename std::vector<predicate_type>::const_iterator it = _filters.begin(); it != _filters.end(); ++it) {
+                        if (!(*it)(item)) {
+                            return false;
+                            }
+                        }
+                    return true;
+                    };
+
+                // Number of matches after the offset, it stops counting at 'max'
+                std::size_t __count(std::size_t max) const {
+                    max = (std::min)(max, _limit);
+                    if (max == 0) {
+                        return 0;
+                        }
+                    std::size_t count = 0;
+                    view_type view = _source->view();
+                    for (typename view_type::const_iterator it = view.begin(); it != view.end(); ++it) {
+                        if (this->__matches(*it) && ++count > _offset && count - _offset == max) {
+                            break;
+                            }
+                        }
+                    return count - (std::min)(count, _offset);
+                    };
+
+                const Source* _source;
+                std::vector<predicate_type> _filters;
+                std::function<bool (const T&, const T&)> _order;
+                std::size_t _offset;
+                std::size_t _limit;
+            };
+
+        /* Immutable copy of the data of a qs_manager (see 'qs_manager::snapshot'). It can be shared among threads, and the
+            references it returns are valid while any copy of the snapshot is alive, whatever happens to the manager.
+        */
+        template <class T, class ID, class Store>
+        class qs_snapshot {
+            public:
+                typedef typename Store::view_type view_type;
+                typedef typename view_type::const_iterator const_iterator;
+
+            public:
+                qs_snapshot() {};
+                explicit qs_snapshot(const std::shared_ptr<const Store>& store) : _store(store) {};
+
+                const_iterator begin() const {
+                    return _store->view().begin();
+                    };
+                const_iterator end() const {
+                    return _store->view().end();
+                    };
+                view_type view() const {
+                    return _store->view();
+                    };
+                std::size_t count() const {
+                    return _store->size();
+                    };
+                void all(std::vector<T>& ret) const {
+                    view_type view = _store->view();
+                    ret.insert(ret.end(), view.begin(), view.end());
+                    };
+                // Pointers to the objects, valid while any copy of the snapshot is alive (see 'qs_manager::all_refs')
+                void all_refs(std::vector<const T*>& ret) const {
+                    view_type view = _store->view();
+                    ret.reserve(ret.size() + view.size());
+                    for (const_iterator it = view.begin(); it != view.end(); ++it) {
+                        ret.push_back(&*it);
+                        }
+                    };
+
+                const T& get(const ID& id) const {
+                    return _private::object_or_throw(_store->try_get(id), id, _store->stats());
+                    };
+                qs_lookup<T> try_get(const ID& id) const {
+                    return _store->try_get(id);
+                    };
+                template <class Range>
+                std::vector<qs_lookup<T> > get_many(const Range& ids) const {
+                    return _store->get_many(ids);
+                    };
+                std::vector<qs_lookup<T> > get_many(std::initializer_list<ID> ids) const {
+                    return _store->get_many(ids);
+                    };
+
+                // Revision of the data this copy was taken from: an opaque value that only changes when the data changes (compare
+                //  it, don't read it as the generation of the container). '0' if unknown, the container may change at any time.
+                std::size_t revision() const {
+                    return _store->revision();
+                    };
+                // Counters for the lookups done on this snapshot (see QS_MANAGER_STATS)
+                const qs_manager_stats& stats() const {
+                    return _store->stats();
+                    };
+                explicit operator bool() const {
+                    return bool(_store);
+                    };
+
+                // Iterate the objects in batches (see 'qs_chunks')
+                qs_chunks<view_type> chunks(std::size_t size) const {
+                    return qs_chunks<view_type>(_store->view(), size);
+                    };
+
+                // Lazy query on the objects of this snapshot (see 'qs_queryset')
+                qs_queryset<T, qs_snapshot> query() const {
+                    return qs_queryset<T, qs_snapshot>(*this);
+                    };
+
+            private:
+                std::shared_ptr<const Store> _store;
+            };
+
+
+/**********************
+    JUST THE CLASS
+***********************/
+
+        namespace _private {
+            template <class T, class ID, class TContainer>
+            class qs_federated_shard;
+            }
+
+        template <class T, class TContainer, class ID=std::string>
+        class qs_manager : public _private::qs_manager_get_impl<T, ID, TContainer>, private _private::qs_manager_observer_base<TContainer, T, ID>::type {
+            public:
+                //typedef typename core::smart_ptr<T>::shared _t_type_ptr; // Just for reference, use signal_ptr, connection_ptr,... instead
+                typedef T _t_type_ptr;
+                typedef std::vector<_t_type_ptr> _t_type_ptr_vector;
+                typedef typename _private::qs_manager_get_impl<T, ID, TContainer>::view_type view_type;
+                typedef typename view_type::const_iterator const_iterator;
+                typedef typename _private::qs_manager_get_impl<T, ID, TContainer>::snapshot_store _snapshot_store;
+                typedef qs_snapshot<T, ID, _snapshot_store> snapshot_type;
+
+                template <class, class, class> friend class _private::qs_federated_shard;
+
+            public:
+                qs_manager(const TContainer& container) : _private::qs_manager_get_impl<T, ID, TContainer>(container), _container(container), _changes(_private::has_observers<TContainer, T, ID>::value ? 1 : 0) {
+                    this->__attach(_private::has_observers<TContainer, T, ID>());
+                    };
+                // Containers the manager builds for itself (indexes, key columns,...) take their memory from 'resource', an
+                //  arena ('qs_monotonic_resource') makes them almost free for managers that live only during a request. Copies
+                //  of the data don't use it (see 'qs_memory_resource').
+                qs_manager(const TContainer& container, qs_memory_resource* resource) : _private::qs_manager_get_impl<T, ID, TContainer>(container), _container(container), _changes(_private::has_observers<TContainer, T, ID>::value ? 1 : 0) {
+                    _indexes.resource(resource);
+                    this->__memory_resource(resource, typename _private::qs_manager_get_impl<T, ID, TContainer>::vector_getter());
+                    this->__attach(_private::has_observers<TContainer, T, ID>());
+                    };
+                // Copies are attached to the container too, so they get its changes like 'other'. They have their own secondary
+                //  indexes (on the same keys) and cache, nothing 'other' builds later is shared with them.
+                qs_manager(const qs_manager& other) : _private::qs_manager_get_impl<T, ID, TContainer>(other), _private::qs_manager_observer_base<TContainer, T, ID>::type(other),
+                    _container(other._container), _publisher(other._publisher), _indexes(other._indexes), _cache(other._cache), _changes(other._changes) {
+                    this->__attach(_private::has_observers<TContainer, T, ID>());
+                    };
+                ~qs_manager() {
+                    this->__detach(_private::has_observers<TContainer, T, ID>());
+                    };
+
+                // Iterate objects without copying them: 'for (const T& item : manager)'
+                //  (if the data has to be copied and the container cannot tell when it changes, both walk the copy taken by
+                //  the last query, iterate 'view()' to take it again)
+                const_iterator begin() const {
+                    this->__load();
+                    return this->__view().begin();
+                    };
+                const_iterator end() const {
+                    this->__load();
+                    return this->__view().end();
+                    };
+                /*
+                // Methods to retrieve ALL data
+                virtual const _t_type_ptr_vector& all() const throw() {
+                    #ifdef LOG_ERROR
+                        LOG_ERROR("Not implemented");
+                        static _t_type_ptr_vector __empty_vector;
+                        return __empty_vector;
+                    #else
+                        throw std::runtime_exception("Not implemneted");
+                    #endif
+                    };
+                */
+                //
+                void test() const noexcept {
+                    std::cout << "void qs_manager::test()" << std::endl;
+                    //this->get("");
+                    //vector = this->all();
+                    };
+                
+                // Methods to filter data: they work directly on the container (in parallel for vectors, so
+                //  'filter_func' may be called from several threads at the same time)
+                _t_type_ptr_vector filter(std::function<bool (const _t_type_ptr& ptr)> filter_func) const {
+                    _t_type_ptr_vector results;
+                    this->filter(filter_func, results);
+                    return results;
+                    };
+
+                int filter(std::function<bool (const _t_type_ptr& ptr)> filter_func, _t_type_ptr_vector& results) const {
+                    std::size_t prev = results.size();
+                    view_type view = this->view();
+                    _private::parallel_filter(view.begin(), view.end(), view.size(), filter_func, results, typename std::iterator_traits<const_iterator>::iterator_category());
+                    return int(results.size() - prev);
+                    };
+
+                // Pointers to the objects instead of copies of them (for map based managers 'all' copies every object), and the
+                //  values of a member, a method or a function of each object. Pointers are valid until the data of the manager is
+                //  updated: the container changes or, for containers copied into the manager, any other call; 'snapshot()' keeps them.
+                std::vector<const T*> all_refs() const {
+                    std::vector<const T*> ret;
+                    this->all_refs(ret);
+                    return ret;
+                    };
+                void all_refs(std::vector<const T*>& ret) const {
+                    view_type view = this->view();
+                    ret.reserve(ret.size() + view.size());
+                    for (const_iterator it = view.begin(); it != view.end(); ++it) {
+                        ret.push_back(&*it);
+                        }
+                    };
+                template <class Extractor>
+                std::vector<typename _private::key_type_of<T, Extractor>::type> project(const Extractor& field) const {
+                    view_type view = this->view();
+                    std::vector<typename _private::key_type_of<T, Extractor>::type> ret;
+                    ret.reserve(view.size());
+                    for (const_iterator it = view.begin(); it != view.end(); ++it) {
+                        ret.push_back(_private::call_key(field, *it));
+                        }
+                    return ret;
+                    };
+
+                // Iterate the objects in batches of 'size' without copying them (see 'qs_chunks'). Unlike 'all', map based
+                //  managers don't build a vector with every object.
+                qs_chunks<view_type> chunks(std::size_t size) const {
+                    return qs_chunks<view_type>(this->view(), size);
+                    };
+
+                // Lazy query on the objects (see 'qs_queryset')
+                qs_queryset<T, qs_manager> query() const {
+                    return qs_queryset<T, qs_manager>(*this);
+                    };
+
+                // Aggregations over the objects of the container without copying them (in parallel for vectors, so the functions
+                //  may be called from several threads at the same time). Values and keys are members ('&T::field'), methods
+                //  ('&T::name') or functions, like 'index_by'.
+                template <class Predicate>
+                std::size_t count_if(const Predicate& predicate) const {
+                    return this->__reduce(std::size_t(0), [&predicate](std::size_t& count, const T& item) {
+                        if (predicate(item)) {
+                            ++count;
+                            }
+                        }, [](std::size_t& count, const std::size_t& partial) {
+                        count += partial;
+                        });
+                    };
+
+                template <class Extractor>
+                typename _private::key_type_of<T, Extractor>::type sum(const Extractor& value) const {
+                    typedef typename _private::key_type_of<T, Extractor>::type value_type;
+                    return this->__reduce(value_type(), [&value](value_type& total, const T& item) {
+                        total += _private::call_key(value, item);
+                        }, [](value_type& total, const value_type& partial) {
+                        total += partial;
+                        });
+                    };
+
+                // Object with the smallest (largest) key, the first one if there are several (not found if there are no objects)
+                template <class Extractor>
+                qs_lookup<T> min_by(const Extractor& key) const {
+                    return this->__best(key, false);
+                    };
+                template <class Extractor>
+                qs_lookup<T> max_by(const Extractor& key) const {
+                    return this->__best(key, true);
+                    };
+
+                // Number of objects for each key, or the sum of 'value' for them
+                template <class Extractor>
+                std::map<typename _private::key_type_of<T, Extractor>::type, std::size_t> group_by(const Extractor& key) const {
+                    return this->group_by(key, [](const T&) { return std::size_t(1); });
+                    };
+                template <class Extractor, class ValueExtractor>
+                std::map<typename _private::key_type_of<T, Extractor>::type, typename _private::key_type_of<T, ValueExtractor>::type> group_by(const Extractor& key, const ValueExtractor& value) const {
+                    typedef std::map<typename _private::key_type_of<T, Extractor>::type, typename _private::key_type_of<T, ValueExtractor>::type> groups_type;
+                    return this->__reduce(groups_type(), [&key, &value](groups_type& groups, const T& item) {
+                        groups[_private::call_key(key, item)] += _private::call_key(value, item);
+                        }, [](groups_type& groups, const groups_type& partial) {
+                        for (typename groups_type::const_iterator it = partial.begin(); it != partial.end(); ++it) {
+                            groups[it->first] += it->second;
+                            }
+                        });
+                    };
+
+                // The first 'n' objects in the order given by a comparator ('before(lhs, rhs)') or by a key (a member, a method or a
+                //  function, ascending unless 'descending'), objects with the same key keep the order of the container. Just 'n'
+                //  pointers are kept while the objects are visited (a heap per thread for vectors, so 'order' may be called from
+                //  several threads at the same time), instead of copying and sorting every object.
+                template <class Order>
+                _t_type_ptr_vector top_k(std::size_t n, const Order& order) const {
+                    return this->__top_k(n, order, std::integral_constant<bool, _private::is_comparator<T, Order>::value>());
+                    };
+                template <class Extractor>
+                _t_type_ptr_vector top_k(std::size_t n, const Extractor& key, bool descending) const {
+                    return this->__top_k(n, _private::qs_key_order<T, Extractor>(key, descending), std::true_type());
+                    };
+
+                // Filters on a key ('qs_eq', 'qs_range' or the predicates of a 'qs_index'): they use a secondary index on
+                //  that key if there is one, otherwise every object is checked.
+                template <class Extractor, class Key>
+                _t_type_ptr_vector filter(const qs_eq_t<Extractor, Key>& predicate) const {
+                    _t_type_ptr_vector results;
+                    this->filter(predicate, results);
+                    return results;
+                    };
+
+                template <class Extractor, class Key>
+                int filter(const qs_eq_t<Extractor, Key>& predicate, _t_type_ptr_vector& results) const {
+                    const _private::qs_secondary_index<T, Key>* index = _indexes.template find<Key>(predicate.key);
+                    if (!index || this->__revision_of_data() == 0) {
+                        return this->filter(std::function<bool (const _t_type_ptr& ptr)>(predicate), results);
+                        }
+                    view_type view = this->view();
+                    const typename _private::qs_manager_items<T>::type& items = this->__indexed_items(*index, view);
+                    std::vector<std::size_t> slots;
+                    index->equal(predicate.value, items, _indexes.epoch(), slots);
+                    return this->__filter_slots(view, slots, predicate, results);
+                    };
+
+                template <class Extractor, class Key>
+                _t_type_ptr_vector filter(const qs_range_t<Extractor, Key>& predicate) const {
+                    _t_type_ptr_vector results;
+                    this->filter(predicate, results);
+                    return results;
+                    };
+
+                template <class Extractor, class Key>
+                int filter(const qs_range_t<Extractor, Key>& predicate, _t_type_ptr_vector& results) const {
+                    const _private::qs_secondary_index<T, Key>* index = _indexes.template find<Key>(predicate.key);
+                    if (index && this->__revision_of_data() != 0) {
+                        view_type view = this->view();
+                        const typename _private::qs_manager_items<T>::type& items = this->__indexed_items(*index, view);
+                        std::vector<std::size_t> slots;
+                        if (index->range(predicate.lo, predicate.hi, items, _indexes.epoch(), slots)) {
+                            return this->__filter_slots(view, slots, predicate, results);
+                            }
+                        }
+                    return this->filter(std::function<bool (const _t_type_ptr& ptr)>(predicate), results);
+                    };
+
+                // Secondary indexes on a key of the objects: a member ('&T::field'), a method ('&T::name') or a function. They
+                //  are built when a filter needs them and rebuilt if the data changed (like 'use_index', they are only used if the
+                //  revision of the data is known, call 'reindex()' if the objects are modified in place). Changes notified by a
+                //  container without 'generation()' are applied to them instead (see 'qs_observer'). Filters on member pointers
+                //  find their index, use the returned 'qs_index' for functions.
+                template <class Extractor>
+                qs_index<T, typename _private::key_type_of<T, Extractor>::type> index_by(const Extractor& key) {
+                    typedef typename _private::key_type_of<T, Extractor>::type key_type;
+                    std::shared_ptr<_private::qs_hash_index<T, key_type, Extractor> > index = std::make_shared<_private::qs_hash_index<T, key_type, Extractor> >(key, _indexes.resource());
+                    _indexes.add(index);
+                    return qs_index<T, key_type>(index.get());
+                    };
+
+                // Same as 'index_by' but the index is sorted, so it is used for ranges too
+                template <class Extractor>
+                qs_index<T, typename _private::key_type_of<T, Extractor>::type> ordered_index_by(const Extractor& key) {
+                    typedef typename _private::key_type_of<T, Extractor>::type key_type;
+                    std::shared_ptr<_private::qs_ordered_index<T, key_type, Extractor> > index = std::make_shared<_private::qs_ordered_index<T, key_type, Extractor> >(key);
+                    _indexes.add(index);
+                    return qs_index<T, key_type>(index.get());
+                    };
+
+                // Cache for 'get' and 'try_get' on containers that are expensive to read ('void all(Container&) const',...): it
+                //  keeps copies of the last 'capacity' objects looked up (and the ids not found), so hot ids don't touch the
+                //  container. Entries are dropped when 'TContainer::generation()' changes, on 'invalidate()', 'reindex()' and
+                //  'publish()'; changes notified by the container (see 'qs_observer') drop just their id. '0' disables it.
+                //  Like the objects of containers copied into the manager, cached objects are valid until the next lookup.
+                //  WARNING: if the container has no 'generation()' and doesn't notify its changes, the manager cannot know
+                //  when it changes and cached entries are NEVER dropped by themselves: call 'invalidate()' after every change.
+                void use_cache(std::size_t capacity) {
+                    static_assert(_private::is_cacheable<ID>::value, "the cache needs ids with std::hash or operator<");
+                    _cache.capacity(capacity);
+                    };
+                // Drops every cached lookup (needed only if the container has no generation and doesn't notify its changes)
+                void invalidate() const {
+                    _cache.clear();
+                    };
+
+                // Force every index to be rebuilt (needed only if items were modified in place)
+                void reindex() const {
+                    _cache.clear();
+                    _indexes.invalidate();
+                    this->__reindex(typename _private::qs_manager_get_impl<T, ID, TContainer>::vector_getter());
+                    };
+
+                // Methods to get data
+                const T& get(const ID& id) const {
+                    return _private::object_or_throw(this->try_get(id), id, this->stats());
+                    };
+                // Same as 'get' but it doesn't throw, the status tells if the object was found
+                qs_lookup<T> try_get(const ID& id) const {
+                    return this->__try_get(id, std::integral_constant<bool, _private::is_cacheable<ID>::value>());
+                    };
+
+                // Copies the object into 'ptr', returns 0 if found, -1 if not found and -2 if multiple objects were found (see 'qs_status').
+                //  Misses don't throw, but errors reading the container or copying the object do.
+                int get(const ID& id, _t_type_ptr& ptr) const {
+                    qs_lookup<T> found = this->try_get(id);
+                    if (found) {
+                        ptr = *found.object;
+                        }
+                    return int(found.status);
+                    };
+
+                // Concurrent reads: 'all', 'get',... reuse buffers inside the manager, so they cannot be called from several
+                //  threads at the same time. Use 'snapshot()' in each thread instead: it returns an immutable copy of the data
+                //  that is shared by all readers and only rebuilt when 'TContainer::generation()' changes or the container
+                //  notifies a change. If it does neither, every call copies the data again (keep the snapshot while it is
+                //  used) and 'publish()' is the same as 'snapshot()'.
+                snapshot_type snapshot() const {
+                    return snapshot_type(_publisher.get(this->__revision_of_data(), [this](std::size_t revision) {
+                        return this->__make_snapshot(revision);
+                        }));
+                    };
+                snapshot_type publish() const {
+                    _cache.clear();
+                    return snapshot_type(_publisher.publish(this->__revision_of_data(), [this](std::size_t revision) {
+                        return this->__make_snapshot(revision);
+                        }, true));
+                    };
+
+                // Counters are only collected if QS_MANAGER_STATS is defined, 'stats().dump(std::cout)' prints them
+                //  and 'stats().values()' exports them
+                void reset_stats() {
+                    this->_stats.reset();
+                    };
+            protected:
+                qs_lookup<T> __try_get(const ID& id, std::true_type) const {
+                    if (!_cache.enabled()) {
+                        return _private::qs_manager_get_impl<T, ID, TContainer>::try_get(id);
+                        }
+                    qs_lookup<T> found;
+                    if (_cache.find(id, _private::qs_manager_generation<TContainer>::of(_container), found)) {
+                        this->stats().lookup();
+                        return found;
+                        }
+                    return _cache.insert(id, _private::qs_manager_get_impl<T, ID, TContainer>::try_get(id));
+                    };
+                qs_lookup<T> __try_get(const ID& id, std::false_type) const {
+                    return _private::qs_manager_get_impl<T, ID, TContainer>::try_get(id);
+                    };
+
+                // Revision of the data: the generation of the container (plus one, it may be '0') or, if it notifies its changes,
+                //  the number of them. '0' if unknown, the container may have changed at any time.
+                std::size_t __revision_of_data() const {
+                    return _private::has_generation<TContainer>::value ? _private::qs_manager_generation<TContainer>::of(_container) + 1 : _changes;
+                    };
+
+                // Table of the secondary indexes to query 'index' (see 'qs_manager_indexes')
+                const typename _private::qs_manager_items<T>::type& __indexed_items(const _private::qs_secondary_index_base<T>& index, const view_type& view) const {
+                    std::size_t epoch = _indexes.epoch();
+                    const typename _private::qs_manager_items<T>::type& items = _indexes.items(index, view, this->__revision_of_data());
+                    if (epoch != _indexes.epoch()) {
+                        this->__locate_changes();
+                        }
+                    return items;
+                    };
+
+                // Objects at the 'slots' an index returned that pass the predicate (stale hits are discarded), in the order of the container
+                template <class Predicate>
+                int __filter_slots(const view_type& view, std::vector<std::size_t>& slots, const Predicate& predicate, _t_type_ptr_vector& results) const {
+                    std::size_t prev = results.size();
+                    std::vector<const T*> objects;
+                    _indexes.objects(view, slots, objects);
+                    for (typename std::vector<const T*>::const_iterator it = objects.begin(); it != objects.end(); ++it) {
+                        if (predicate(**it)) {
+                            results.push_back(**it);
+                            }
+                        }
+                    return int(results.size() - prev);
+                    };
+
+                // Reduces the objects calling 'func(acc, item)', 'combine(acc, partial)' merges the results of each thread
+                template <class Acc, class Func, class Combine>
+                Acc __reduce(const Acc& identity, const Func& func, const Combine& combine) const {
+                    view_type view = this->view();
+                    return _private::parallel_reduce(view.begin(), view.end(), view.size(), identity, func, combine, typename std::iterator_traits<const_iterator>::iterator_category());
+                    };
+
+                template <class Compare>
+                _t_type_ptr_vector __top_k(std::size_t n, const Compare& before, std::true_type) const {
+                    view_type view = this->view();
+                    _private::qs_top_k<T, Compare> heap(n, before);
+                    heap.reserve(view.size());
+                    _private::parallel_top_k(view.begin(), view.end(), view.size(), heap, [](const T&) { return true; }, typename std::iterator_traits<const_iterator>::iterator_category());
+                    const std::vector<std::pair<const T*, std::size_t> >& best = heap.sorted();
+                    _t_type_ptr_vector results;
+                    results.reserve(best.size());
+                    for (typename std::vector<std::pair<const T*, std::size_t> >::const_iterator it = best.begin(); it != best.end(); ++it) {
+                        results.push_back(*it->first);
+                        }
+                    return results;
+                    };
+                template <class Extractor>
+                _t_type_ptr_vector __top_k(std::size_t n, const Extractor& key, std::false_type) const {
+                    return this->__top_k(n, _private::qs_key_order<T, Extractor>(key, false), std::true_type());
+                    };
+
+                template <class Extractor>
+                qs_lookup<T> __best(const Extractor& key, bool largest) const {
+                    auto better = [&key, largest](const T& lhs, const T& rhs) {
+                        return largest ? _private::call_key(key, rhs) < _private::call_key(key, lhs) : _private::call_key(key, lhs) < _private::call_key(key, rhs);
+                        };
+                    const T* best = this->__reduce(static_cast<const T*>(nullptr), [&better](const T*& acc, const T& item) {
+                        if (!acc || better(item, *acc)) {
+                            acc = &item;
+                            }
+                        }, [&better](const T*& acc, const T* const& partial) {
+                        if (partial && (!acc || better(*partial, *acc))) {
+                            acc = partial;
+                            }
+                        });
+                    return best ? qs_lookup<T>(qs_status::found, best) : qs_lookup<T>();
+                    };
+
+                void __reindex(std::true_type) const {
+                    _private::qs_manager_get_impl<T, ID, TContainer>::reindex();
+                    };
+                void __reindex(std::false_type) const {};
+
+                void __memory_resource(qs_memory_resource* resource, std::true_type) {
+                    _private::qs_manager_get_impl<T, ID, TContainer>::__memory_resource(resource);
+                    };
+                void __memory_resource(qs_memory_resource*, std::false_type) {};
+
+                // Containers that notify their changes (see 'qs_observer')
+                void __attach(std::true_type) {
+                    this->__observe();
+                    _indexes.observe();
+                    _container.attach(this);
+                    };
+                void __attach(std::false_type) {};
+                void __detach(std::true_type) {
+                    _container.detach(this);
+                    };
+                void __detach(std::false_type) {};
+
+                void on_insert(const ID& id, const T& item) {
+                    this->__changed(_private::qs_change::insert, id, &item, _private::has_observers<TContainer, T, ID>());
+                    };
+                void on_erase(const ID& id) {
+                    this->__changed(_private::qs_change::erase, id, nullptr, _private::has_observers<TContainer, T, ID>());
+                    };
+                void on_update(const ID& id, const T& item) {
+                    this->__changed(_private::qs_change::update, id, &item, _private::has_observers<TContainer, T, ID>());
+                    };
+                void __changed(_private::qs_change change, const ID& id, const T* item, std::true_type) {
+                    std::size_t previous = this->__revision_of_data();
+                    ++_changes;
+                    _cache.erase(id);
+                    _private::qs_change_place<T> place = this->__on_change(change, id, item);
+                    _indexes.apply(change, id, place, this->__view(), previous, this->__revision_of_data());
+                    };
+                void __changed(_private::qs_change, const ID&, const T*, std::false_type) {};
+
+                // The container cannot be replaced (copies are attached to the same one)
+                qs_manager& operator=(const qs_manager&);
+
+                const TContainer& _container;
+                _private::qs_manager_publisher<_snapshot_store> _publisher;
+                _private::qs_manager_indexes<T, ID> _indexes;
+                _private::qs_manager_cache<T, ID> _cache;
+                std::size_t _changes; // notified by the container, '0' if it doesn't notify them
+            };
+
+/**********************
+    FEDERATED
+***********************/
+        namespace _private {
+            // Source of a qs_federated_manager, whatever the adapter of its container is
+            template <class T, class ID>
+            class qs_federated_source {
+                public:
+                    virtual ~qs_federated_source() {};
+
+                    virtual qs_lookup<T> try_get(const ID& id) const = 0;
+                    virtual std::size_t count() const = 0;
+                    virtual void all(std::vector<T>& ret) const = 0;
+                    virtual void filter(const std::function<bool (const T&)>& filter_func, std::vector<T>& results) const = 0;
+                    // Number of objects the last time the data was updated (it doesn't update it)
+                    virtual std::size_t size_hint() const = 0;
+                };
+
+            template <class T, class ID, class TContainer>
+            class qs_federated_shard : public qs_federated_source<T, ID> {
+                public:
+                    explicit qs_federated_shard(const TContainer& container) : _manager(container) {};
+                    qs_federated_shard(const TContainer& container, qs_memory_resource* resource) : _manager(container, resource) {};
+
+                    qs_manager<T, TContainer, ID>& manager() {
+                        return _manager;
+                        };
+
+                    virtual qs_lookup<T> try_get(const ID& id) const {
+                        return _manager.try_get(id);
+                        };
+                    virtual std::size_t count() const {
+                        return _manager.count();
+                        };
+                    virtual void all(std::vector<T>& ret) const {
+                        typename qs_manager<T, TContainer, ID>::view_type view = _manager.view();
+                        ret.insert(ret.end(), view.begin(), view.end());
+                        };
+                    virtual void filter(const std::function<bool (const T&)>& filter_func, std::vector<T>& results) const {
+                        _manager.filter(filter_func, results);
+                        };
+                    virtual std::size_t size_hint() const {
+                        return _manager.__view().size();
+                        };
+
+                private:
+                    qs_manager<T, TContainer, ID> _manager;
+                };
+            }
+
+        /* Manager over data partitioned across several containers (one per shard, loader thread,...), each of them with
+            its own qs_manager whatever its adapter is. Calls fan out to the shards and gather their results in the order the
+            shards were added:
+            * get: shards are looked at one after another, an id found in several shards raises 'multiple_objects_found'
+              like duplicates inside a shard, and the rest are skipped as soon as the result is known. With 'route_by' only
+              one shard is looked at.
+            * count, all, filter: results of every shard, taken in parallel if there are enough objects (see
+              QS_MANAGER_PARALLEL_MIN_CHUNK), so 'filter_func' may be called from several threads at the same time.
+            Like qs_manager, it cannot be used from several threads at the same time (see 'qs_manager::snapshot').
+        */
+        template <class T, class ID=std::string>
+        class qs_federated_manager {
+            public:
+                typedef std::vector<T> _t_type_ptr_vector;
+
+            public:
+                qs_federated_manager() : _unique_ids(false) {};
+
+                // Adds a shard, the returned manager can be configured ('use_index', 'index_by',...) and it is valid while
+                //  this one is alive
+                template <class TContainer>
+                qs_manager<T, TContainer, ID>& add(const TContainer& container) {
+                    return this->__add(new _private::qs_federated_shard<T, ID, TContainer>(container));
+                    };
+                template <class TContainer>
+                qs_manager<T, TContainer, ID>& add(const TContainer& container, qs_memory_resource* resource) {
+                    return this->__add(new _private::qs_federated_shard<T, ID, TContainer>(container, resource));
+                    };
+                std::size_t shards() const {
+                    return _shards.size();
+                    };
+
+                // Ids are in shard 'route(id) % shards()' (in the order they were added), so lookups only look at that
+                //  shard: 'route_by(std::hash<ID>())' for containers partitioned by hash. An empty function looks at all of them.
+                void route_by(std::function<std::size_t (const ID&)> route) {
+                    _route = route;
+                    };
+                // Ids are never repeated across shards: lookups stop at the first shard that finds the object instead of
+                //  looking for it in the others too.
+                void unique_ids(bool enable = true) {
+                    _unique_ids = enable;
+                    };
+
+                const T& get(const ID& id) const {
+                    return _private::object_or_throw(this->try_get(id), id, _stats);
+                    };
+
+                // Same as 'get' but it doesn't throw, the status tells if the object was found
+                qs_lookup<T> try_get(const ID& id) const {
+                    qs_manager_stats::timer timer(_stats);
+                    _stats.lookup();
+                    if (_route && !_shards.empty()) {
+                        return _shards[_route(id) % _shards.size()]->try_get(id);
+                        }
+                    // One lookup per shard is cheaper than starting threads for them, shards are looked at one after another
+                    qs_lookup<T> ret;
+                    for (std::size_t shard = 0; shard < _shards.size(); ++shard) {
+                        qs_lookup<T> found = _shards[shard]->try_get(id);
+                        if (found.status == qs_status::multiple_found || (found.status == qs_status::found && ret.status == qs_status::found)) {
+                            return qs_lookup<T>(qs_status::multiple_found);
+                            }
+                        if (found.status == qs_status::found) {
+                            if (_unique_ids) {
+                                return found;
+                                }
+                            ret = found;
+                            }
+                        }
+                    return ret;
+                    };
+
+                std::size_t count() const {
+                    std::vector<std::size_t> counts(_shards.size());
+                    this->__for_each_shard([this, &counts](std::size_t shard) {
+                        counts[shard] = _shards[shard]->count();
+                        });
+                    std::size_t total = 0;
+                    for (std::size_t shard = 0; shard < counts.size(); ++shard) {
+                        total += counts[shard];
+                        }
+                    return total;
+                    };
+
+                _t_type_ptr_vector all() const {
+                    _t_type_ptr_vector ret;
+                    this->all(ret);
+                    return ret;
+                    };
+                void all(_t_type_ptr_vector& ret) const {
+                    this->__gather(ret, [this](std::size_t shard, _t_type_ptr_vector& partial) {
+                        _shards[shard]->all(partial);
+                        });
+                    };
+
+                _t_type_ptr_vector filter(std::function<bool (const T&)> filter_func) const {
+                    _t_type_ptr_vector results;
+                    this->filter(filter_func, results);
+                    return results;
+                    };
+                int filter(std::function<bool (const T&)> filter_func, _t_type_ptr_vector& results) const {
+                    std::size_t prev = results.size();
+                    this->__gather(results, [this, &filter_func](std::size_t shard, _t_type_ptr_vector& partial) {
+                        _shards[shard]->filter(filter_func, partial);
+                        });
+                    return int(results.size() - prev);
+                    };
+
+                // Counters for the lookups done on this manager, each shard has its own (see QS_MANAGER_STATS)
+                const qs_manager_stats& stats() const {
+                    return _stats;
+                    };
+                void reset_stats() {
+                    _stats.reset();
+                    };
+
+            protected:
+                template <class TContainer>
+                qs_manager<T, TContainer, ID>& __add(_private::qs_federated_shard<T, ID, TContainer>* shard) {
+                    std::unique_ptr<_private::qs_federated_shard<T, ID, TContainer> > owner(shard);
+                    qs_manager<T, TContainer, ID>& manager = owner->manager();
+                    _shards.push_back(std::move(owner));
+                    return manager;
+                    };
+
+                // Calls 'func(shard)' for every shard, in parallel if they have enough objects
+                template <class Func>
+                void __for_each_shard(const Func& func) const {
+                    std::size_t size = 0;
+                    for (std::size_t shard = 0; shard < _shards.size(); ++shard) {
+                        size += _shards[shard]->size_hint();
+                        }
+                    std::size_t chunks = (std::min)(_shards.size(), _private::qs_parallel::chunks(size));
+                    _private::qs_parallel::run(_shards.size(), chunks, [&func](std::size_t, std::size_t begin, std::size_t end) {
+                        for (std::size_t shard = begin; shard != end; ++shard) {
+                            func(shard);
+                            }
+                        });
+                    };
+
+                // Appends to 'results' what 'func(shard, partial)' returns for every shard, in the order of the shards
+                template <class Func>
+                void __gather(_t_type_ptr_vector& results, const Func& func) const {
+                    std::vector<_t_type_ptr_vector> partial(_shards.size());
+                    this->__for_each_shard([&func, &partial](std::size_t shard) {
+                        func(shard, partial[shard]);
+                        });
+                    std::size_t total = results.size();
+                    for (std::size_t shard = 0; shard < partial.size(); ++shard) {
+                        total += partial[shard].size();
+                        }
+                    results.reserve(total);
+                    for (std::size_t shard = 0; shard < partial.size(); ++shard) {
+                        results.insert(results.end(), std::make_move_iterator(partial[shard].begin()), std::make_move_iterator(partial[shard].end()));
+                        }
+                    };
+
+                std::vector<std::unique_ptr<_private::qs_federated_source<T, ID> > > _shards;
+                std::function<std::size_t (const ID&)> _route;
+                bool _unique_ids;
+                qs_manager_stats _stats;
+            };
+
+        }
+    }
+
+                
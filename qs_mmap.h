@@ -0,0 +1,324 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#ifdef _WIN32
+    // Only the file mapping API and no 'min'/'max' macros, the macros defined here are removed after the include
+    #ifndef NOMINMAX
+        #define NOMINMAX
+        #define QS_MMAP_DEFINED_NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+        #define QS_MMAP_DEFINED_WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+    #ifdef QS_MMAP_DEFINED_NOMINMAX
+        #undef NOMINMAX
+        #undef QS_MMAP_DEFINED_NOMINMAX
+    #endif
+    #ifdef QS_MMAP_DEFINED_WIN32_LEAN_AND_MEAN
+        #undef WIN32_LEAN_AND_MEAN
+        #undef QS_MMAP_DEFINED_WIN32_LEAN_AND_MEAN
+    #endif
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+#include "qs_manager.h"
+
+/* Read-only maps stored in flat binary files that are mapped in memory, so a qs_manager works on them as soon as the file
+    is opened: nothing is parsed nor copied ('get', 'view', 'filter',... point into the mapping) and the OS loads the pages
+    lookups touch. Keys and objects must be trivially copyable (no pointers, no std::string,...) and the file can only be
+    read where it was written (sizes and endianness are checked when it is opened).
+        qs_mmap_map<int, T>::write("table.qs", manager.freeze());   // or a std::map, a vector of pairs,...
+        qs_mmap_map<int, T> table("table.qs");
+        qs_manager<T, qs_mmap_map<int, T>, std::string> manager(table);
+*/
+
+namespace core {
+    namespace utils {
+
+        class qs_mmap_error : public std::runtime_error {
+            public:
+                qs_mmap_error(const std::string& path, const std::string& what) : std::runtime_error(std::string("Cannot map '") + path + "': " + what) {};
+            };
+
+        // Pair stored in the file
+        template <class Key, class T>
+        struct qs_mmap_entry {
+            typedef Key first_type;
+            typedef T second_type;
+
+            Key first;
+            T second;
+            };
+
+        namespace _private {
+            /* Layout of the files: this header and, at 'offset', 'count' entries sorted by key (they are the index, lookups
+                are binary searches like 'qs_sorted_vector').
+            */
+            struct qs_mmap_header {
+                char magic[8];
+                std::uint32_t version;
+                std::uint32_t endianness;
+                std::uint64_t key_size;
+                std::uint64_t object_size;
+                std::uint64_t entry_size;
+                std::uint64_t offset;
+                std::uint64_t count;
+                };
+
+            inline const char* qs_mmap_magic() {
+                return "QSMMAP1"; // 8 bytes with the trailing '\0'
+                };
+            static const std::uint32_t qs_mmap_version = 1;
+            static const std::uint32_t qs_mmap_endianness = 0x01020304;
+
+            // A file mapped in memory (read only) while this object is alive
+            class qs_mmap_file {
+                public:
+                    explicit qs_mmap_file(const std::string& path) : _data(nullptr), _size(0) {
+                    #ifdef _WIN32
+                        _mapping = NULL;
+                        _file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+                        if (_file == INVALID_HANDLE_VALUE) {
+                            throw qs_mmap_error(path, "cannot open the file");
+                            }
+                        LARGE_INTEGER size;
+                        if (!::GetFileSizeEx(_file, &size)) {
+                            this->__close();
+                            throw qs_mmap_error(path, "cannot read its size");
+                            }
+                        _size = std::size_t(size.QuadPart);
+                        if (_size < sizeof(qs_mmap_header)) {
+                            this->__close();
+                            throw qs_mmap_error(path, "file too small");
+                            }
+                        _mapping = ::CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+                        _data = _mapping ? static_cast<const char*>(::MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+                        if (!_data) {
+                            this->__close();
+                            throw qs_mmap_error(path, "cannot map the file");
+                            }
+                    #else
+                        int fd = ::open(path.c_str(), O_RDONLY);
+                        if (fd < 0) {
+                            throw qs_mmap_error(path, std::strerror(errno));
+                            }
+                        struct stat info;
+                        if (::fstat(fd, &info) != 0) {
+                            int error = errno;
+                            ::close(fd);
+                            throw qs_mmap_error(path, std::strerror(error));
+                            }
+                        _size = std::size_t(info.st_size);
+                        if (_size < sizeof(qs_mmap_header)) {
+                            ::close(fd);
+                            throw qs_mmap_error(path, "file too small");
+                            }
+                        void* data = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+                        int error = errno;
+                        ::close(fd); // the mapping keeps the file open
+                        if (data == MAP_FAILED) {
+                            throw qs_mmap_error(path, std::strerror(error));
+                            }
+                        _data = static_cast<const char*>(data);
+                    #endif
+                        };
+                    ~qs_mmap_file() {
+                        this->__close();
+                        };
+
+                    const char* data() const {
+                        return _data;
+                        };
+                    std::size_t size() const {
+                        return _size;
+                        };
+
+                private:
+                    qs_mmap_file(const qs_mmap_file&);
+                    qs_mmap_file& operator=(const qs_mmap_file&);
+
+                    void __close() {
+                    #ifdef _WIN32
+                        if (_data) {
+                            ::UnmapViewOfFile(_data);
+                            }
+                        if (_mapping) {
+                            ::CloseHandle(_mapping);
+                            }
+                        ::CloseHandle(_file);
+                    #else
+                        if (_data) {
+                            ::munmap(const_cast<char*>(_data), _size);
+                            }
+                    #endif
+                        _data = nullptr;
+                        };
+
+                #ifdef _WIN32
+                    HANDLE _file;
+                    HANDLE _mapping;
+                #endif
+                    const char* _data;
+                    std::size_t _size;
+                };
+            }
+
+        /* Read-only sorted map over a file mapped in memory (see above). Copies share the mapping, which lives while any
+            of them is alive. Objects with the same key are kept together in the order they were written (a 'qs_manager'
+            reports them as 'multiple_found').
+        */
+        template <class Key, class T, class Compare = std::less<Key> >
+        class qs_mmap_map {
+            public:
+                typedef Key key_type;
+                typedef T mapped_type;
+                typedef qs_mmap_entry<Key, T> value_type;
+                typedef Compare key_compare;
+                typedef const value_type* const_iterator;
+                typedef const_iterator iterator;
+                typedef std::size_t size_type;
+
+                static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<T>::value, "qs_mmap_map only stores trivially copyable keys and objects");
+
+            public:
+                explicit qs_mmap_map(const Compare& comp = Compare()) : _data(nullptr), _size(0), _comp(comp) {};
+                explicit qs_mmap_map(const std::string& path, const Compare& comp = Compare()) : _file(std::make_shared<const _private::qs_mmap_file>(path)), _data(nullptr), _size(0), _comp(comp) {
+                    _private::qs_mmap_header header;
+                    std::memcpy(&header, _file->data(), sizeof(header));
+                    if (std::memcmp(header.magic, _private::qs_mmap_magic(), sizeof(header.magic)) != 0 || header.version != _private::qs_mmap_version) {
+                        throw qs_mmap_error(path, "not a qs_mmap_map file");
+                        }
+                    if (header.endianness != _private::qs_mmap_endianness || header.key_size != sizeof(Key) || header.object_size != sizeof(T) || header.entry_size != sizeof(value_type)) {
+                        throw qs_mmap_error(path, "written for other types or other platform");
+                        }
+                    if (header.offset < sizeof(header) || header.offset % alignof(value_type) != 0 || header.offset > _file->size() || header.count > (_file->size() - header.offset)/sizeof(value_type)) {
+                        throw qs_mmap_error(path, "truncated or corrupted file");
+                        }
+                    _data = reinterpret_cast<const value_type*>(_file->data() + header.offset);
+                    _size = size_type(header.count);
+                    };
+
+                // Writes the (key, object) pairs of [first, last) to 'path' (anything with 'first' and 'second': a map, a
+                //  'qs_sorted_vector',...), they don't need to be sorted.
+                template <class InputIterator>
+                static void write(const std::string& path, InputIterator first, InputIterator last, const Compare& comp = Compare()) {
+                    value_type zero;
+                    std::memset(&zero, 0, sizeof(zero)); // padding is written too
+                    std::vector<value_type> entries;
+                    for (; first != last; ++first) {
+                        entries.push_back(zero);
+                        entries.back().first = first->first;
+                        entries.back().second = first->second;
+                        }
+                    std::stable_sort(entries.begin(), entries.end(), [&comp](const value_type& lhs, const value_type& rhs) { return comp(lhs.first, rhs.first); });
+
+                    _private::qs_mmap_header header;
+                    std::memset(&header, 0, sizeof(header));
+                    std::memcpy(header.magic, _private::qs_mmap_magic(), sizeof(header.magic));
+                    header.version = _private::qs_mmap_version;
+                    header.endianness = _private::qs_mmap_endianness;
+                    header.key_size = sizeof(Key);
+                    header.object_size = sizeof(T);
+                    header.entry_size = sizeof(value_type);
+                    header.offset = (sizeof(header) + alignof(value_type) - 1)/alignof(value_type)*alignof(value_type);
+                    header.count = entries.size();
+
+                    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+                    if (!out) {
+                        throw qs_mmap_error(path, "cannot create the file");
+                        }
+                    const std::vector<char> padding(std::size_t(header.offset) - sizeof(header), '\0');
+                    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                    out.write(padding.data(), std::streamsize(padding.size()));
+                    out.write(reinterpret_cast<const char*>(entries.data()), std::streamsize(entries.size()*sizeof(value_type)));
+                    out.close();
+                    if (!out) {
+                        throw qs_mmap_error(path, "cannot write the file");
+                        }
+                    };
+                template <class Range>
+                static void write(const std::string& path, const Range& data, const Compare& comp = Compare()) {
+                    write(path, std::begin(data), std::end(data), comp);
+                    };
+
+                const_iterator begin() const { return _data; };
+                const_iterator end() const { return _data + _size; };
+                size_type size() const { return _size; };
+                bool empty() const { return _size == 0; };
+                key_compare key_comp() const { return _comp; };
+
+                void swap(qs_mmap_map& other) {
+                    _file.swap(other._file);
+                    std::swap(_data, other._data);
+                    std::swap(_size, other._size);
+                    std::swap(_comp, other._comp);
+                    };
+
+                const_iterator lower_bound(const key_type& key) const {
+                    const Compare& comp = _comp;
+                    return this->__search([&comp, &key](const key_type& item) { return comp(item, key); });
+                    };
+                const_iterator upper_bound(const key_type& key) const {
+                    const Compare& comp = _comp;
+                    return this->__search([&comp, &key](const key_type& item) { return !comp(key, item); });
+                    };
+                std::pair<const_iterator, const_iterator> equal_range(const key_type& key) const {
+                    return std::make_pair(this->lower_bound(key), this->upper_bound(key));
+                    };
+                const_iterator find(const key_type& key) const {
+                    const_iterator it = this->lower_bound(key);
+                    return (it == this->end() || _comp(key, it->first)) ? this->end() : it;
+                    };
+                size_type count(const key_type& key) const {
+                    std::pair<const_iterator, const_iterator> range = this->equal_range(key);
+                    return size_type(range.second - range.first);
+                    };
+
+            protected:
+                // Branchless binary search, see 'qs_sorted_vector'
+                template <class Before>
+                const_iterator __search(const Before& before) const {
+                    size_type n = _size;
+                    if (n == 0) {
+                        return this->end();
+                        }
+                    const value_type* base = _data;
+                    while (n > 1) {
+                        size_type half = n / 2;
+                        base = before(base[half].first) ? base + half : base;
+                        n -= half;
+                        }
+                    return base + (before(base->first) ? 1 : 0);
+                    };
+
+                std::shared_ptr<const _private::qs_mmap_file> _file;
+                const value_type* _data;
+                size_type _size;
+                Compare _comp;
+            };
+
+        namespace _private {
+            // qs_manager works on them like on any 'qs_sorted_vector'
+            template <class T, class ID, class Key, class Compare>
+            struct is_map_container<qs_mmap_map<Key, T, Compare>, T, ID> : std::integral_constant<bool, qs_manager_id_to_key<ID, Key>::value> {};
+            template <class Key, class T, class Compare>
+            struct is_sorted_vector<qs_mmap_map<Key, T, Compare> > : std::true_type {};
+            }
+
+        }
+    }